@@ -15,10 +15,75 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "cache.h"
+#include "cachefile.h"
+#include "cachejournal.h"
+#include "durablefile.h"
 #include <fstream>
 #include <filesystem>
+#include <map>
+#include <algorithm>
 #include <cinttypes>
 
+/// The journal is folded into the cache file once it is this big,
+/// replaying it must not take longer than reading the cache file.
+#define CACHE_JOURNAL_COMPACT_SIZE (1024 * 1024)
+
+/// Items loaded in one go, lookups of paths below the items loaded
+/// so far do not wait for the rest of the cache.
+#define CACHE_SHARD_SIZE 4096
+
+namespace {
+
+std::string parentDirectory(const std::string& path)
+{
+    auto pos = path.find_last_of('/');
+    if (pos == std::string::npos)
+        return std::string();
+    return path.substr(0, pos);
+}
+
+std::string_view parentDirectory(std::string_view path)
+{
+    auto pos = path.find_last_of('/');
+    if (pos == std::string_view::npos)
+        return std::string_view();
+    return path.substr(0, pos);
+}
+
+/// path is dir or below dir
+bool isBelow(std::string_view path, std::string_view dir)
+{
+    return path.size() >= dir.size() && !path.compare(0, dir.size(), dir) &&
+        (path.size() == dir.size() || path[dir.size()] == '/');
+}
+
+/// path has been removed by one of the journaled directory removals
+bool isRemoved(std::string_view path, const std::vector<std::string>& removed)
+{
+    for (const auto &dir : removed) {
+        if (isBelow(path, dir))
+            return true;
+    }
+    return false;
+}
+
+/// first path sorted behind dir and everything below it, '0' follows '/'
+std::string subtreeEnd(std::string_view dir)
+{
+    std::string end(dir);
+    end.push_back('0');
+    return end;
+}
+
+/// lookup key of a possibly moved file, a collision only makes a
+/// file a candidate which is not
+unsigned long renameKey(unsigned long hash, unsigned long size)
+{
+    return hash ^ (size + 0x9e3779b97f4a7c15UL + (hash << 6) + (hash >> 2));
+}
+
+} // namespace
+
 Cache::Cache(const std::string& path)
     : cachePath_(path)
 {
@@ -28,19 +93,283 @@ Cache::Cache(const std::string& path)
 Cache::~Cache()
 {
     LOG_DEBUG(MEDIA_INDEXER_CACHE, "Cache dtor! path : %s", cachePath_.c_str());
-    cacheMap_.clear();
-    cacheItems_.clear();
+    clear();
 }
 
 void Cache::insertItem(const std::string& uri, const unsigned long& hash,
-                       const MediaItem::Type& type, const std::string& thumbnailFile)
+                       const MediaItem::Type& type, const std::string& thumbnailFile,
+                       const unsigned long& size, const unsigned long& inode)
+{
+    auto count = waitFor(uri);
+    auto pos = shardFor(uri, count);
+    if (pos < count) {
+        auto idx = shards_[pos]->index.findItem(uri);
+        if (idx != CacheIndex::npos)
+            markSeen(*shards_[pos], idx, false);
+    }
+    cacheItems_.emplace(uri, std::make_tuple(hash, type, thumbnailFile, size, inode));
+    pendingItems_.insert(uri);
+    journal().appendItem(uri, hash, type, thumbnailFile, size, inode);
+}
+
+void Cache::updateItem(const std::string& uri, const unsigned long& hash,
+                       const MediaItem::Type& type, const std::string& thumbnailFile,
+                       const unsigned long& size, const unsigned long& inode)
+{
+    auto count = waitFor(uri);
+    auto pos = shardFor(uri, count);
+    if (pos < count) {
+        auto idx = shards_[pos]->index.findItem(uri);
+        if (idx != CacheIndex::npos)
+            markSeen(*shards_[pos], idx, false);
+    }
+    cacheItems_.insert_or_assign(uri, std::make_tuple(hash, type, thumbnailFile, size, inode));
+    pendingItems_.insert(uri);
+    journal().appendItem(uri, hash, type, thumbnailFile, size, inode);
+}
+
+std::optional<CacheMap::mapped_type> Cache::getItem(const std::string& uri) const
+{
+    auto iter = cacheItems_.find(uri);
+    if (iter != cacheItems_.end())
+        return iter->second;
+    auto count = waitFor(uri);
+    auto pos = shardFor(uri, count);
+    if (pos >= count)
+        return std::nullopt;
+    const auto &shard = *shards_[pos];
+    auto idx = shard.index.findItem(uri);
+    if (idx == CacheIndex::npos || !shard.kept[idx])
+        return std::nullopt;
+    return indexItem(shard, idx);
+}
+
+CacheMap Cache::removeItems(const std::string& path)
+{
+    // remove the item itself or everything below a directory
+    journal().appendRemove(path);
+    CacheMap removed;
+    std::string prefix = path + "/";
+    for (auto iter = cacheItems_.begin(); iter != cacheItems_.end();) {
+        if (iter->first == path || !iter->first.compare(0, prefix.size(), prefix)) {
+            pendingItems_.erase(iter->first);
+            removed.emplace(iter->first, std::move(iter->second));
+            iter = cacheItems_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    // an item is still valid if it has been kept or not visited yet
+    auto count = waitForSubtree(path);
+    for (size_t pos = 0; pos < count; ++pos) {
+        auto &shard = *shards_[pos];
+        auto removeIndexItem = [&] (uint32_t idx) {
+            if (shard.kept[idx] || !shard.seen[idx])
+                removed.emplace(shard.index.path(idx), indexItem(shard, idx));
+            markSeen(shard, idx, false);
+        };
+        auto idx = shard.index.findItem(path);
+        if (idx != CacheIndex::npos)
+            removeIndexItem(idx);
+        for (auto dir = shard.index.lowerBoundDir(path); dir < shard.index.dirCount(); ++dir) {
+            auto dirPath = shard.index.dirPath(dir);
+            if (dirPath.compare(0, path.size(), path))
+                break;
+            if (!isBelow(dirPath, path))
+                continue;
+            const auto &entry = shard.index.dir(dir);
+            for (auto item = entry.firstItem; item < entry.endItem; ++item)
+                removeIndexItem(item);
+        }
+    }
+
+    for (auto iter = dirItems_.begin(); iter != dirItems_.end();) {
+        if (iter->first == path || !iter->first.compare(0, prefix.size(), prefix))
+            iter = dirItems_.erase(iter);
+        else
+            ++iter;
+    }
+    return removed;
+}
+
+void Cache::insertDirectory(const std::string& dir, const unsigned long& hash)
+{
+    dirItems_.insert_or_assign(dir, std::make_pair(hash, 0UL));
+    incompleteDirs_.insert(dir);
+}
+
+void Cache::completeDirectory(const std::string& dir)
 {
-    cacheItems_.emplace(uri, std::make_tuple(hash, type, thumbnailFile));
+    incompleteDirs_.erase(dir);
+}
+
+bool Cache::carryOverDirectory(const std::string& dir, const unsigned long& hash,
+                               std::vector<std::string>& subdirs,
+                               std::vector<MediaItem::Type>& types)
+{
+    // the entries of a directory may be spread over several shards,
+    // the directory itself is stored in only one of them
+    auto count = waitForSubtree(dir);
+    if (count == 0)
+        return false;
+    auto first = shardFor(dir, count);
+    auto last = shardFor(subtreeEnd(dir), count);
+    const CacheIndex::Dir *known = nullptr;
+    unsigned long entries = 0;
+    for (auto pos = first; pos <= last; ++pos) {
+        const auto &index = shards_[pos]->index;
+        auto idx = index.findDir(dir);
+        if (idx == CacheIndex::npos)
+            continue;
+        const auto &entry = index.dir(idx);
+        // files of an interrupted scan have to be checked one by one
+        if (entry.pending)
+            return false;
+        if (entry.known)
+            known = &entry;
+        entries += entry.endItem - entry.firstItem;
+    }
+    if (!known || known->hash != hash)
+        return false;
+
+    // stored subdirectories, everything below one of them is skipped
+    std::vector<std::string_view> children;
+    for (auto pos = first; pos <= last; ++pos) {
+        const auto &index = shards_[pos]->index;
+        auto idx = index.lowerBoundDir(dir + "/");
+        while (idx < index.dirCount()) {
+            auto path = index.dirPath(idx);
+            if (!isBelow(path, dir))
+                break;
+            // siblings like "a (2)" or "a.bak" sort between "a" and
+            // "a/", only the range of "a/" is skipped
+            auto end = path.find('/', dir.size() + 1);
+            if (end != std::string_view::npos) {
+                idx = index.lowerBoundDir(subtreeEnd(path.substr(0, end)));
+                continue;
+            }
+            if (index.dir(idx).known)
+                children.push_back(path);
+            ++idx;
+        }
+    }
+    entries += children.size();
+    if (entries != known->count) {
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "entry count mismatch for '%s', %lu != %lu",
+                dir.c_str(), entries, known->count);
+        return false;
+    }
+
+    // the directory has not been touched, take over its files as
+    // they are
+    for (auto pos = first; pos <= last; ++pos) {
+        auto &shard = *shards_[pos];
+        auto idx = shard.index.findDir(dir);
+        if (idx == CacheIndex::npos)
+            continue;
+        const auto &entry = shard.index.dir(idx);
+        for (auto item = entry.firstItem; item < entry.endItem; ++item) {
+            if (shard.seen[item])
+                continue;
+            types.push_back(shard.index.item(item).type);
+            markSeen(shard, item, true);
+        }
+    }
+    for (const auto &child : children)
+        subdirs.emplace_back(child);
+
+    dirItems_.insert_or_assign(dir, std::make_pair(known->hash, known->count));
+    return true;
+}
+
+void Cache::carryOverOutside(const std::string& path,
+                             std::vector<MediaItem::Type>& types)
+{
+    // take over everything which is not below path, only the subtree
+    // is left to be checked
+    auto count = waitLoaded();
+    for (size_t pos = 0; pos < count; ++pos) {
+        auto &shard = *shards_[pos];
+        for (uint32_t dir = 0; dir < shard.index.dirCount(); ++dir) {
+            auto dirPath = shard.index.dirPath(dir);
+            if (isBelow(dirPath, path))
+                continue;
+            const auto &entry = shard.index.dir(dir);
+            for (auto item = entry.firstItem; item < entry.endItem; ++item) {
+                if (shard.seen[item])
+                    continue;
+                types.push_back(shard.index.item(item).type);
+                markSeen(shard, item, true);
+            }
+            if (entry.known)
+                dirItems_.insert_or_assign(std::string(dirPath), std::make_pair(entry.hash, entry.count));
+        }
+    }
+}
+
+bool Cache::isRenameCandidate(const unsigned long& hash, const unsigned long& size) const
+{
+    // the keys are complete before the first shard is published
+    return renameKeys_.find(renameKey(hash, size)) != renameKeys_.end();
+}
+
+bool Cache::carryOverRenamed(const std::string& uri, const unsigned long& hash,
+                             const unsigned long& size, const unsigned long& inode,
+                             std::string& oldUri)
+{
+    // only items which have not been seen in this scan can have been
+    // moved, a file keeps its inode when moved on most file systems,
+    // on vfat it keeps at least its name when the folder is renamed
+    std::string_view name(uri);
+    name.remove_prefix(name.find_last_of('/') + 1);
+    std::pair<Shard *, uint32_t> match, sameInode, sameName;
+    size_t matches = 0, sameInodes = 0, sameNames = 0;
+    auto count = waitLoaded();
+    for (size_t pos = 0; pos < count; ++pos) {
+        auto &shard = *shards_[pos];
+        auto range = shard.index.itemsByHash(hash);
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            const auto &item = shard.index.item(*iter);
+            if (shard.seen[*iter] || item.size != size)
+                continue;
+            match = std::make_pair(&shard, *iter);
+            matches++;
+            if (inode && item.inode == inode) {
+                sameInode = match;
+                sameInodes++;
+            }
+            if (shard.index.name(*iter) == name) {
+                sameName = match;
+                sameNames++;
+            }
+        }
+    }
+
+    if (sameInodes == 1)
+        match = sameInode;
+    else if (sameNames == 1)
+        match = sameName;
+    else if (matches != 1)
+        return false;
+
+    auto &shard = *match.first;
+    oldUri = shard.index.path(match.second);
+    auto item = indexItem(shard, match.second);
+    journal().appendItem(uri, hash, std::get<1>(item), std::get<2>(item), size, inode);
+    journal().appendRemove(oldUri);
+    cacheItems_.insert_or_assign(uri, std::make_tuple(hash, std::get<1>(item),
+            std::move(std::get<2>(item)), size, inode));
+    pendingItems_.insert(uri);
+    markSeen(shard, match.second, false);
+    return true;
 }
 
 int Cache::size() const
 {
-    return cacheMap_.size();
+    // items still being loaded are not counted yet
+    std::lock_guard<std::mutex> lock(loadLock_);
+    return itemCount_ - seenCount_;
 }
 
 const std::string& Cache::getPath() const
@@ -48,6 +377,11 @@ const std::string& Cache::getPath() const
     return cachePath_;
 }
 
+std::string Cache::getLegacyPath() const
+{
+    return parentDirectory(cachePath_) + "/" + CACHE_JSONFILE;
+}
+
 bool Cache::setPath(const std::string& path)
 {
     if (path.empty()) {
@@ -61,44 +395,317 @@ bool Cache::setPath(const std::string& path)
 
 bool Cache::generateCacheFile()
 {
-    // remove cache file first
-    std::string path = getPath();
-    std::filesystem::remove(path);
-
-    std::ofstream outputFile(path);
-    if (!outputFile.is_open()) {
-        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "cache file generation fail! need to check '%s'", path.c_str());
+    if (!writeCacheFile(false))
         return false;
+    // everything is in the cache file now
+    journal().discard();
+
+    // whatever has not been visited is gone
+    auto count = waitLoaded();
+    for (size_t pos = 0; pos < count; ++pos) {
+        auto &shard = *shards_[pos];
+        for (uint32_t idx = 0; idx < shard.index.size(); ++idx) {
+            if (!shard.seen[idx])
+                markSeen(shard, idx, false);
+        }
     }
+    incompleteDirs_.clear();
+    pendingItems_.clear();
+    resumable_ = false;
+
+    return true;
+}
+
+bool Cache::saveCheckpoint()
+{
+    if (journal().size() < CACHE_JOURNAL_COMPACT_SIZE)
+        return journal().flush();
+
+    // the journal may only go once the cache file containing its
+    // records is on the disk
+    if (!writeCacheFile(true))
+        return false;
+    journal().discard();
+    return true;
+}
+
+bool Cache::saveChanges()
+{
+    // outside of a scan the cache is complete, a compaction writes
+    // the final cache file
+    if (journal().size() < CACHE_JOURNAL_COMPACT_SIZE)
+        return journal().flush();
+    return generateCacheFile();
+}
 
-    //JSonComposer composer;
-    //auto cache = Composer.tojson(path);
-    auto cache = pbnjson::Object();
-    auto uri_array = pbnjson::Array();
-    auto hash_array = pbnjson::Array();
-    auto type_array = pbnjson::Array();
-    auto thumbnail_array = pbnjson::Array();
+CacheJournal& Cache::journal()
+{
+    if (!journal_)
+        journal_ = std::make_unique<CacheJournal>(getPath() + CACHE_JOURNAL_SUFFIX);
+    return *journal_;
+}
+
+bool Cache::writeCacheFile(bool checkpoint)
+{
+    auto count = waitLoaded();
+
+    // remove the commit marker first, the pending items of the new
+    // file are not committed yet
+    std::string path = getPath();
+    UnlinkBatch marker;
+    marker.add(path + CACHE_COMMIT_SUFFIX);
+    marker.commit();
+
+    CacheFile::Writer writer;
+    std::unordered_map<std::string_view, unsigned long> counts;
     for (const auto &item : cacheItems_) {
-        uri_array.append(item.first);
-        hash_array.append(std::to_string(std::get<0>(item.second)));
-        type_array.append(static_cast<int32_t>(std::get<1>(item.second)));
-        thumbnail_array.append(std::get<2>(item.second));
+        writer.addItem(item.first, std::get<0>(item.second), std::get<1>(item.second),
+            std::get<2>(item.second), std::get<3>(item.second), std::get<4>(item.second),
+            pendingItems_.find(item.first) != pendingItems_.end());
+        counts[parentDirectory(std::string_view(item.first))]++;
+    }
+    // a checkpoint keeps the items which have not been visited yet,
+    // they are still in the database
+    for (size_t pos = 0; pos < count; ++pos) {
+        const auto &shard = *shards_[pos];
+        for (uint32_t idx = 0; idx < shard.index.size(); ++idx) {
+            if (!shard.kept[idx] && (shard.seen[idx] || !checkpoint))
+                continue;
+            const auto &item = shard.index.item(idx);
+            writer.addItem(shard.index.path(idx), item.hash, item.type, shard.index.thumbnail(idx),
+                item.size, item.inode, item.pending);
+            counts[shard.index.dirPath(item.dir)]++;
+        }
+    }
+
+    // only directories whose files have all been handled are stored.
+    // A checkpoint keeps the old state of all directories, subdirectories
+    // of a directory read in this scan may still be queued and would be
+    // missing from its entry count.
+    std::vector<std::tuple<std::string_view, unsigned long, unsigned long>> dirs;
+    if (checkpoint) {
+        for (size_t pos = 0; pos < count; ++pos) {
+            const auto &index = shards_[pos]->index;
+            for (uint32_t idx = 0; idx < index.dirCount(); ++idx) {
+                const auto &entry = index.dir(idx);
+                if (entry.known)
+                    dirs.emplace_back(index.dirPath(idx), entry.hash, entry.count);
+            }
+        }
+    } else {
+        for (const auto &item : dirItems_) {
+            if (incompleteDirs_.find(item.first) == incompleteDirs_.end())
+                dirs.emplace_back(item.first, item.second.first, item.second.second);
+        }
     }
-    cache.put("uri", uri_array);
-    cache.put("hash", hash_array);
-    cache.put("type", type_array);
-    cache.put("thumbnail", thumbnail_array);
 
-    outputFile << pbnjson::JGenerator::serialize(cache, pbnjson::JSchemaFragment("{}"));
-    outputFile.close();
-    cacheMap_.clear();
+    // the entry count lets us detect directory entries which do not
+    // match the items stored along with them
+    for (const auto &dir : dirs)
+        counts[parentDirectory(std::get<0>(dir))]++;
+    for (const auto &dir : dirs)
+        writer.addDir(std::get<0>(dir), std::get<1>(dir), counts[std::get<0>(dir)]);
 
+    if (!writer.write(path, !checkpoint))
+        return false;
+
+    // the legacy cache file is outdated now
+    UnlinkBatch legacy;
+    legacy.add(getLegacyPath() + CACHE_COMMIT_SUFFIX);
+    legacy.add(getLegacyPath());
     return true;
 }
 
 bool Cache::readCache()
 {
     std::string path = getPath();
+    auto file = std::make_unique<CacheFile>();
+    if (!file->open(path)) {
+        if (std::filesystem::exists(getLegacyPath())) {
+            LOG_INFO(MEDIA_INDEXER_CACHE, 0, "read legacy cache file '%s'", getLegacyPath().c_str());
+            return readLegacyCache(getLegacyPath());
+        }
+        // the first scan of the device has been interrupted before the
+        // cache file has been written
+        if (!std::filesystem::exists(path + CACHE_JOURNAL_SUFFIX))
+            return false;
+    }
+
+    // changes since the cache file has been written, the last record
+    // of a path wins
+    JournalChanges changes;
+    std::vector<std::string> removed;
+    auto records = journal().replay([&] (CacheJournal::Record &&rec) {
+        if (rec.type == CacheJournal::Record::Type::Remove) {
+            for (auto iter = changes.lower_bound(rec.path);
+                 iter != changes.end() && !iter->first.compare(0, rec.path.size(), rec.path); ++iter) {
+                if (isBelow(iter->first, rec.path))
+                    iter->second.reset();
+            }
+            removed.push_back(std::move(rec.path));
+        } else {
+            auto path = rec.path;
+            changes.insert_or_assign(std::move(path), std::move(rec));
+        }
+    });
+
+    // items of a scan which has not been committed completely have to
+    // be checked against the database again, so have journaled items
+    bool committed = std::filesystem::exists(path + CACHE_COMMIT_SUFFIX);
+    size_t pending = 0;
+    if (!committed) {
+        for (size_t idx = 0; idx < file->itemCount(); idx++)
+            pending += file->item(idx).pending;
+    }
+    for (const auto &change : changes)
+        pending += change.second.has_value();
+    resumable_ = !file->complete() || pending > 0 || records > 0;
+
+    if (records > 0)
+        LOG_INFO(MEDIA_INDEXER_CACHE, 0, "%zu journal records replayed for '%s'", records, path.c_str());
+    if (resumable_)
+        LOG_INFO(MEDIA_INDEXER_CACHE, 0, "resume interrupted scan, %zu pending items", pending);
+
+    // moved files are looked up by content, not by path, so the keys
+    // can not wait for the shards. They are taken from the fixed width
+    // records in place, without touching the strings but the journaled
+    // paths. The records are not checked yet, a damaged one only makes
+    // a file a candidate which is not.
+    for (size_t idx = 0; idx < file->itemCount(); idx++) {
+        auto item = file->item(idx);
+        if (item.size && changes.find(item.path) == changes.end() &&
+            (removed.empty() || !isRemoved(item.path, removed)))
+            renameKeys_.insert(renameKey(item.hash, item.size));
+    }
+    for (const auto &change : changes) {
+        if (change.second && change.second->size)
+            renameKeys_.insert(renameKey(change.second->hash, change.second->size));
+    }
+
+    // the walk starts right away, lookups only wait for the part of
+    // the cache they need
+    shards_.resize((file->itemCount() + changes.size()) / CACHE_SHARD_SIZE + 1);
+    loaded_ = false;
+    stopLoad_ = false;
+    loader_ = std::thread(&Cache::load, this, std::move(file), std::move(changes),
+        std::move(removed), committed);
+    return true;
+}
+
+void Cache::load(std::unique_ptr<CacheFile> file, JournalChanges changes,
+                 std::vector<std::string> removed, bool committed)
+{
+    // the cache file items and the journal changes are both sorted by
+    // path, merge them and cut the result into shards
+    auto shard = std::make_unique<Shard>();
+    size_t fileIdx = 0, dirIdx = 0, items = 0;
+    auto addDirs = [&] (const std::string *next) {
+        for (; dirIdx < file->dirCount(); dirIdx++) {
+            auto dir = file->dir(dirIdx);
+            if (next && dir.path >= *next)
+                break;
+            if (removed.empty() || !isRemoved(dir.path, removed))
+                shard->index.addDir(dir.path, dir.hash, dir.count);
+        }
+    };
+    auto change = changes.begin();
+    while (!stopLoad_) {
+        std::optional<CacheFile::Item> fileItem;
+        for (; fileIdx < file->itemCount() && !fileItem; fileIdx++) {
+            // the items of a damaged block are found again by the walk
+            if (!file->verified(fileIdx))
+                continue;
+            auto item = file->item(fileIdx);
+            if (changes.find(item.path) == changes.end() && (removed.empty() || !isRemoved(item.path, removed)))
+                fileItem = item;
+        }
+        while (change != changes.end() && !change->second)
+            ++change;
+        bool fromJournal = change != changes.end() && (!fileItem || change->first < fileItem->path);
+        if (!fromJournal && !fileItem)
+            break;
+        // the file item is taken again next time
+        if (fromJournal && fileItem)
+            fileIdx--;
+
+        if (items == CACHE_SHARD_SIZE) {
+            std::string next(fromJournal ? std::string_view(change->first) : fileItem->path);
+            addDirs(&next);
+            publishShard(std::move(shard), next, false);
+            shard = std::make_unique<Shard>();
+            shard->first = std::move(next);
+            items = 0;
+        }
+        if (fromJournal) {
+            const auto &rec = *change->second;
+            shard->index.addItem(change->first, rec.hash, rec.mediaType, rec.thumbnail,
+                rec.size, rec.inode, true);
+            ++change;
+        } else {
+            shard->index.addItem(fileItem->path, fileItem->hash, fileItem->type, fileItem->thumbnail,
+                fileItem->size, fileItem->inode, !committed && fileItem->pending);
+        }
+        items++;
+    }
+    addDirs(nullptr);
+    publishShard(std::move(shard), std::string(), true);
+}
+
+void Cache::publishShard(std::unique_ptr<Shard> shard, const std::string& next, bool last)
+{
+    shard->index.build();
+    shard->seen.assign(shard->index.size(), false);
+    shard->kept.assign(shard->index.size(), false);
+
+    std::lock_guard<std::mutex> lock(loadLock_);
+    itemCount_ += shard->index.size();
+    shards_[shardCount_++] = std::move(shard);
+    watermark_ = next;
+    loaded_ = last;
+    loadCond_.notify_all();
+}
+
+void Cache::stopLoading()
+{
+    stopLoad_ = true;
+    if (loader_.joinable())
+        loader_.join();
+}
+
+size_t Cache::waitFor(std::string_view path) const
+{
+    std::unique_lock<std::mutex> lock(loadLock_);
+    loadCond_.wait(lock, [this, path] () { return loaded_ || path < watermark_; });
+    return shardCount_;
+}
+
+size_t Cache::waitForSubtree(std::string_view dir) const
+{
+    auto end = subtreeEnd(dir);
+    std::unique_lock<std::mutex> lock(loadLock_);
+    loadCond_.wait(lock, [this, &end] () { return loaded_ || end <= watermark_; });
+    return shardCount_;
+}
+
+size_t Cache::waitLoaded() const
+{
+    std::unique_lock<std::mutex> lock(loadLock_);
+    loadCond_.wait(lock, [this] () { return loaded_; });
+    return shardCount_;
+}
+
+size_t Cache::shardFor(std::string_view path, size_t count) const
+{
+    // the last shard starting at or before path, the first one starts
+    // with the empty path
+    auto begin = shards_.begin();
+    auto iter = std::upper_bound(begin, begin + count, path,
+        [] (std::string_view key, const std::unique_ptr<Shard> &shard) { return key < shard->first; });
+    return iter == begin ? shards_.size() : (iter - begin) - 1;
+}
+
+bool Cache::readLegacyCache(const std::string& path)
+{
     // get the JDOM tree from given path
     auto root = pbnjson::JDomParser::fromFile(path.c_str());
     if (!root.isObject()) {
@@ -106,7 +713,7 @@ bool Cache::readCache()
         return false;
     }
 
-    if (!root.hasKey("uri") || !root.hasKey("hash") || 
+    if (!root.hasKey("uri") || !root.hasKey("hash") ||
         !root.hasKey("type") || !root.hasKey("thumbnail")) {
         LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "can't find 'uri' and 'hash' field!");
         return false;
@@ -126,58 +733,166 @@ bool Cache::readCache()
         return false;
     }
 
+    // items of a scan which has not been committed completely have to
+    // be checked against the database again
+    std::unordered_set<std::string> pendingItems;
+    bool committed = std::filesystem::exists(path + CACHE_COMMIT_SUFFIX);
+    if (!committed && root.hasKey("pending")) {
+        auto pendingList = root["pending"];
+        for (int idx = 0; idx < pendingList.arraySize(); idx++)
+            pendingItems.insert(pendingList[idx].asString());
+    }
+    resumable_ = (root.hasKey("complete") && !root["complete"].asBool()) || !pendingItems.empty();
+
+    // size and inode are optional, older cache files do not have them
+    // and their items are never taken as moved files
+    bool fileInfo = root.hasKey("size") && root.hasKey("inode") &&
+        root["size"].arraySize() == uri_count && root["inode"].arraySize() == uri_count;
+    auto sizeList = root["size"];
+    auto inodeList = root["inode"];
+
+    // the legacy file is read only once before it is replaced, it goes
+    // into a single shard
+    auto shard = std::make_unique<Shard>();
     for (int idx = 0; idx < uri_count; idx++) {
         auto uri = uriList[idx].asString();
         auto hash = std::stoul(hashList[idx].asString());
         auto type = static_cast<MediaItem::Type>(typeList[idx].asNumber<int32_t>());
         auto thumb = thumbList[idx].asString();
-        cacheMap_.emplace(uri, std::make_tuple(hash, type, thumb));
+        unsigned long size = fileInfo ? std::stoul(sizeList[idx].asString()) : 0;
+        unsigned long inode = fileInfo ? std::stoul(inodeList[idx].asString()) : 0;
+        bool pending = pendingItems.find(uri) != pendingItems.end();
+        shard->index.addItem(uri, hash, type, thumb, size, inode, pending);
+        // items without size are never taken as moved files
+        if (size)
+            renameKeys_.insert(renameKey(hash, size));
+    }
+
+    // directory entries are optional, older cache files do not have them
+    if (root.hasKey("dir") && root.hasKey("dirHash") && root.hasKey("dirCount")) {
+        auto dirList = root["dir"];
+        auto dirHashList = root["dirHash"];
+        auto dirCountList = root["dirCount"];
+        int dir_count = dirList.arraySize();
+        if (dir_count == dirHashList.arraySize() && dir_count == dirCountList.arraySize()) {
+            for (int idx = 0; idx < dir_count; idx++) {
+                auto dir = dirList[idx].asString();
+                auto hash = std::stoul(dirHashList[idx].asString());
+                auto count = std::stoul(dirCountList[idx].asString());
+                shard->index.addDir(dir, hash, count);
+            }
+        } else {
+            LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "count mismatch in directory entries, ignore them");
+        }
     }
+    shards_.resize(1);
+    publishShard(std::move(shard), std::string(), true);
 
-    // remove cache file
-    std::filesystem::remove(getPath());
-    sync();
+    if (resumable_)
+        LOG_INFO(MEDIA_INDEXER_CACHE, 0, "resume interrupted scan, %zu pending items", pendingItems.size());
     return true;
 }
 
-bool Cache::isExist(const std::string& uri, const unsigned long& hash)
+void Cache::markSeen(Shard& shard, uint32_t idx, bool keep)
 {
-    bool ret = false;
-    auto iter = cacheMap_.find(uri);
-    if (iter != cacheMap_.end() && std::get<0>(iter->second) == hash) {
-        cacheItems_.emplace(uri, std::make_tuple(std::get<0>(iter->second), 
-                    std::get<1>(iter->second), std::get<2>(iter->second)));
-        ret = true;
+    if (!shard.seen[idx]) {
+        shard.seen[idx] = true;
+        std::lock_guard<std::mutex> lock(loadLock_);
+        seenCount_++;
     }
+    shard.kept[idx] = keep;
+}
+
+CacheMap::mapped_type Cache::indexItem(const Shard& shard, uint32_t idx) const
+{
+    const auto &item = shard.index.item(idx);
+    return std::make_tuple(item.hash, item.type, std::string(shard.index.thumbnail(idx)),
+        item.size, item.inode);
+}
+
+bool Cache::isResumable() const
+{
+    return resumable_;
+}
+
+bool Cache::isExist(const std::string& uri, const unsigned long& hash)
+{
+    auto count = waitFor(uri);
+    auto pos = shardFor(uri, count);
+    if (pos >= count)
+        return false;
+    auto &shard = *shards_[pos];
+    auto idx = shard.index.findItem(uri);
+    if (idx == CacheIndex::npos || shard.seen[idx])
+        return false;
 
-    cacheMap_.erase(uri);
-    return ret;
+    const auto &item = shard.index.item(idx);
+    bool keep = item.hash == hash && !item.pending;
+    markSeen(shard, idx, keep);
+    return keep;
 }
 
 void Cache::resetCache()
 {
-    std::filesystem::remove(getPath());
-    cacheMap_.clear();
-    cacheItems_.clear();
+    stopLoading();
+    UnlinkBatch files;
+    files.add(getPath() + CACHE_COMMIT_SUFFIX);
+    files.add(getPath());
+    files.add(getLegacyPath() + CACHE_COMMIT_SUFFIX);
+    files.add(getLegacyPath());
+    files.commit();
+    journal().discard();
+    clear();
 }
 
 void Cache::clear()
 {
-    cacheMap_.clear();
+    stopLoading();
+    {
+        std::lock_guard<std::mutex> lock(loadLock_);
+        shards_.clear();
+        shardCount_ = 0;
+        watermark_.clear();
+        loaded_ = true;
+        itemCount_ = 0;
+        seenCount_ = 0;
+        renameKeys_.clear();
+    }
     cacheItems_.clear();
+    dirItems_.clear();
+    incompleteDirs_.clear();
+    pendingItems_.clear();
+    resumable_ = false;
 }
 
-const CacheMap& Cache::getRemainingCache() const
+CacheMap Cache::getRemainingCache() const
 {
-    return cacheMap_;
+    CacheMap remaining;
+    auto count = waitLoaded();
+    for (size_t pos = 0; pos < count; ++pos) {
+        const auto &shard = *shards_[pos];
+        for (uint32_t idx = 0; idx < shard.index.size(); ++idx) {
+            if (!shard.seen[idx])
+                remaining.emplace(shard.index.path(idx), indexItem(shard, idx));
+        }
+    }
+    return remaining;
 }
 
 void Cache::printCache() const
 {
     LOG_DEBUG(MEDIA_INDEXER_CACHE, "--------------Cached Items--------------");
-    for (const auto &item : cacheMap_)
-        LOG_DEBUG(MEDIA_INDEXER_CACHE, "uri : '%s', hash : '%lu', type : '%d', thumbnail : '%s'",
-                item.first.c_str(), std::get<0>(item.second), std::get<1>(item.second),
-                std::get<2>(item.second));
+    auto count = waitLoaded();
+    for (size_t pos = 0; pos < count; ++pos) {
+        const auto &shard = *shards_[pos];
+        for (uint32_t idx = 0; idx < shard.index.size(); ++idx) {
+            if (shard.seen[idx])
+                continue;
+            const auto &item = shard.index.item(idx);
+            LOG_DEBUG(MEDIA_INDEXER_CACHE, "uri : '%s', hash : '%lu', type : '%d', thumbnail : '%s'",
+                    shard.index.path(idx).c_str(), item.hash, item.type,
+                    std::string(shard.index.thumbnail(idx)).c_str());
+        }
+    }
     LOG_DEBUG(MEDIA_INDEXER_CACHE, "----------------------------------------");
 }
@@ -17,15 +17,35 @@
 #pragma once
 
 #include "mediaitem.h"
+#include "cacheindex.h"
+#include "cachejournal.h"
 #include <pbnjson.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <tuple>
+#include <thread>
 #include <utility>
+#include <vector>
 
-/// alias
+/// marker file next to the cache file, exists once the pending items
+/// of the cache file are in the database
+#define CACHE_COMMIT_SUFFIX ".committed"
+
+class CacheFile;
+
+/// alias, uri -> (hash, type, thumbnail, size, inode)
 using CacheMap = std::unordered_map<std::string, 
-                                    std::tuple<unsigned long, MediaItem::Type, std::string>>;
+                                    std::tuple<unsigned long, MediaItem::Type, std::string,
+                                               unsigned long, unsigned long>>;
 using CacheMapIterator = CacheMap::iterator;
+/// directory path -> (modification hash, entry count)
+using DirCacheMap = std::unordered_map<std::string, std::pair<unsigned long, unsigned long>>;
 
 /// Cache class based on media uri and hash
 class Cache
@@ -35,25 +55,118 @@ public:
     ~Cache();
 
     void insertItem(const std::string& uri, const unsigned long& hash,
-                    const MediaItem::Type& type, const std::string& thumbnailFile);
+                    const MediaItem::Type& type, const std::string& thumbnailFile,
+                    const unsigned long& size = 0, const unsigned long& inode = 0);
+    void updateItem(const std::string& uri, const unsigned long& hash,
+                    const MediaItem::Type& type, const std::string& thumbnailFile,
+                    const unsigned long& size = 0, const unsigned long& inode = 0);
+    std::optional<CacheMap::mapped_type> getItem(const std::string& uri) const;
+    CacheMap removeItems(const std::string& path);
+    void insertDirectory(const std::string& dir, const unsigned long& hash);
+    void completeDirectory(const std::string& dir);
+    bool carryOverDirectory(const std::string& dir, const unsigned long& hash,
+                            std::vector<std::string>& subdirs,
+                            std::vector<MediaItem::Type>& types);
+    void carryOverOutside(const std::string& path,
+                          std::vector<MediaItem::Type>& types);
+    /// whether a file missing in the cache may have been moved, does
+    /// not block while the cache is still being loaded, the keys are
+    /// known before the first shard
+    bool isRenameCandidate(const unsigned long& hash, const unsigned long& size) const;
+    bool carryOverRenamed(const std::string& uri, const unsigned long& hash,
+                          const unsigned long& size, const unsigned long& inode,
+                          std::string& oldUri);
     int size() const;
     const std::string& getPath() const;
+    std::string getLegacyPath() const;
     bool setPath(const std::string& path);
     bool generateCacheFile();
+    bool saveCheckpoint();
+    bool saveChanges();
     bool readCache();
+    bool isResumable() const;
     bool isExist(const std::string& uri, const unsigned long& hash);
     void resetCache();
     void clear();
     void printCache() const;
-    const CacheMap& getRemainingCache() const;
+    CacheMap getRemainingCache() const;
 
  private:
-    /// cacheMap
-    CacheMap cacheMap_;
+    /// Part of the cached items, covers the paths from first up to
+    /// the first path of the next shard.
+    struct Shard {
+        std::string first;
+        CacheIndex index;
+        /// items visited in this scan and those of them which are
+        /// still valid
+        std::vector<bool> seen;
+        std::vector<bool> kept;
+    };
+
+    /// journal records, the last record of a path wins, removed
+    /// paths have no record
+    using JournalChanges = std::map<std::string, std::optional<CacheJournal::Record>, std::less<>>;
+
+    bool writeCacheFile(bool checkpoint);
+    CacheJournal& journal();
+    bool readLegacyCache(const std::string& path);
+    /// fill the shards from the cache file and the journal in path order
+    void load(std::unique_ptr<CacheFile> file, JournalChanges changes,
+              std::vector<std::string> removed, bool committed);
+    /// stop loading and wait for the loader
+    void stopLoading();
+    /// make a filled shard visible, everything below next is loaded
+    void publishShard(std::unique_ptr<Shard> shard, const std::string& next, bool last);
+    /// wait until the part of the cache containing path is loaded,
+    /// gives the number of shards available
+    size_t waitFor(std::string_view path) const;
+    /// wait until everything below dir is loaded
+    size_t waitForSubtree(std::string_view dir) const;
+    /// wait until the whole cache is loaded
+    size_t waitLoaded() const;
+    /// the shard path belongs to
+    size_t shardFor(std::string_view path, size_t count) const;
+    /// item has been visited, keep tells whether it is still valid
+    void markSeen(Shard& shard, uint32_t idx, bool keep);
+    CacheMap::mapped_type indexItem(const Shard& shard, uint32_t idx) const;
+
+    /// items read from the cache file in path order, never changed
+    /// during a scan. Allocated up front, the loader fills them one
+    /// by one while the cache is already in use.
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t shardCount_ = 0;
+    /// paths below this one are loaded
+    std::string watermark_;
+    bool loaded_ = true;
+    size_t itemCount_ = 0;
+    size_t seenCount_ = 0;
+    mutable std::mutex loadLock_;
+    mutable std::condition_variable loadCond_;
+    std::thread loader_;
+    std::atomic<bool> stopLoad_ = false;
+    /// hash and size keys of all cached items, filled before the
+    /// loader starts and not changed during a scan
+    std::unordered_set<unsigned long> renameKeys_;
 
-    /// cacheList for generate Cache file
+    /// items added or changed since the cache file has been read
     CacheMap cacheItems_;
 
+    /// directories for generate Cache file
+    DirCacheMap dirItems_;
+
+    /// directories which have been read but whose files are not yet
+    /// all handled
+    std::unordered_set<std::string> incompleteDirs_;
+
+    /// changed items which may not be in the database yet
+    std::unordered_set<std::string> pendingItems_;
+
+    /// the cache file has been written in the middle of a scan
+    bool resumable_ = false;
+
+    /// changes since the cache file has been written
+    std::unique_ptr<CacheJournal> journal_;
+
     /// media item cache path
     std::string cachePath_;
 };
@@ -0,0 +1,380 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "cachefile.h"
+#include "durablefile.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// File magic and format version, bump the version on any layout change.
+#define CACHE_FILE_MAGIC "MIDXCACH"
+#define CACHE_FILE_VERSION 2
+
+/// Number of item records checksummed together.
+#define CACHE_FILE_BLOCK_ITEMS 4096
+
+/// Header flag, the file describes a finished scan.
+#define CACHE_FILE_COMPLETE 0x1
+/// Item flag, the item may not be in the database yet.
+#define CACHE_ITEM_PENDING 0x1
+
+struct CacheFile::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t itemCount;
+    uint32_t dirCount;
+    uint64_t stringsSize;
+    /// Strings of the item records, the directory strings follow.
+    uint64_t itemStringsSize;
+    uint32_t blockCount;
+    /// FNV-1a over the block table.
+    uint32_t blockChecksum;
+    /// FNV-1a over the directory records and their strings.
+    uint32_t dirChecksum;
+    uint32_t reserved;
+};
+
+/// Item records of a block and their strings, which are stored in
+/// record order.
+struct CacheFile::Block {
+    /// End of the strings of this block, they start where the ones of
+    /// the previous block end.
+    uint64_t stringsEnd;
+    /// FNV-1a over the records and the strings.
+    uint32_t checksum;
+    uint32_t reserved;
+};
+
+struct CacheFile::ItemRecord {
+    uint64_t hash;
+    uint64_t size;
+    uint64_t inode;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t thumbnailOffset;
+    uint32_t thumbnailLength;
+    int32_t type;
+    uint32_t flags;
+};
+
+struct CacheFile::DirRecord {
+    uint64_t hash;
+    uint64_t count;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+namespace {
+
+uint32_t checksum(const char *data, size_t length, uint32_t sum = 2166136261u)
+{
+    for (size_t idx = 0; idx < length; ++idx) {
+        sum ^= static_cast<unsigned char>(data[idx]);
+        sum *= 16777619u;
+    }
+    return sum;
+}
+
+} // namespace
+
+void CacheFile::Writer::addItem(std::string_view path, unsigned long hash, MediaItem::Type type,
+    std::string_view thumbnail, unsigned long size, unsigned long inode, bool pending)
+{
+    items_.push_back({std::string(path), std::string(thumbnail), hash, size, inode, type, pending});
+}
+
+void CacheFile::Writer::addDir(std::string_view path, unsigned long hash, unsigned long count)
+{
+    dirs_.emplace_back(std::string(path), std::make_pair(hash, count));
+}
+
+bool CacheFile::Writer::write(const std::string &path, bool complete)
+{
+    // sorted records allow binary search lookups on the mapped file
+    std::sort(items_.begin(), items_.end(),
+        [] (const PendingItem &a, const PendingItem &b) { return a.path < b.path; });
+    std::sort(dirs_.begin(), dirs_.end(),
+        [] (const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::string strings;
+    auto addString = [&strings] (const std::string &str, uint32_t &offset, uint32_t &length) {
+        offset = static_cast<uint32_t>(strings.size());
+        length = static_cast<uint32_t>(str.size());
+        strings.append(str);
+    };
+
+    std::vector<ItemRecord> items(items_.size());
+    std::vector<Block> blocks((items_.size() + CACHE_FILE_BLOCK_ITEMS - 1) / CACHE_FILE_BLOCK_ITEMS);
+    for (size_t idx = 0; idx < items_.size(); ++idx) {
+        const auto &src = items_[idx];
+        auto &rec = items[idx];
+        rec.hash = src.hash;
+        rec.size = src.size;
+        rec.inode = src.inode;
+        rec.type = static_cast<int32_t>(src.type);
+        rec.flags = src.pending ? CACHE_ITEM_PENDING : 0;
+        addString(src.path, rec.pathOffset, rec.pathLength);
+        addString(src.thumbnail, rec.thumbnailOffset, rec.thumbnailLength);
+        if ((idx + 1) % CACHE_FILE_BLOCK_ITEMS == 0 || idx + 1 == items_.size())
+            blocks[idx / CACHE_FILE_BLOCK_ITEMS].stringsEnd = strings.size();
+    }
+    auto itemStringsSize = strings.size();
+    for (size_t block = 0; block < blocks.size(); ++block) {
+        auto first = block * CACHE_FILE_BLOCK_ITEMS;
+        auto count = std::min<size_t>(CACHE_FILE_BLOCK_ITEMS, items.size() - first);
+        auto begin = block ? blocks[block - 1].stringsEnd : 0;
+        auto sum = checksum(reinterpret_cast<const char *>(items.data() + first), count * sizeof(ItemRecord));
+        blocks[block].checksum = checksum(strings.data() + begin, blocks[block].stringsEnd - begin, sum);
+        blocks[block].reserved = 0;
+    }
+
+    std::vector<DirRecord> dirs(dirs_.size());
+    for (size_t idx = 0; idx < dirs_.size(); ++idx) {
+        auto &rec = dirs[idx];
+        rec.hash = dirs_[idx].second.first;
+        rec.count = dirs_[idx].second.second;
+        addString(dirs_[idx].first, rec.pathOffset, rec.pathLength);
+    }
+
+    if (strings.size() > UINT32_MAX) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "cache string table too big for '%s'", path.c_str());
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_FILE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_FILE_VERSION;
+    header.flags = complete ? CACHE_FILE_COMPLETE : 0;
+    header.itemCount = static_cast<uint32_t>(items.size());
+    header.dirCount = static_cast<uint32_t>(dirs.size());
+    header.stringsSize = strings.size();
+    header.itemStringsSize = itemStringsSize;
+    header.blockCount = static_cast<uint32_t>(blocks.size());
+    header.blockChecksum = checksum(reinterpret_cast<const char *>(blocks.data()), blocks.size() * sizeof(Block));
+    auto sum = checksum(reinterpret_cast<const char *>(dirs.data()), dirs.size() * sizeof(DirRecord));
+    header.dirChecksum = checksum(strings.data() + itemStringsSize, strings.size() - itemStringsSize, sum);
+
+    // the old file stays in place until the new one is on the disk
+    DurableFile file(path);
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) &&
+        file.write(reinterpret_cast<const char *>(blocks.data()), blocks.size() * sizeof(Block)) &&
+        file.write(reinterpret_cast<const char *>(items.data()), items.size() * sizeof(ItemRecord)) &&
+        file.write(reinterpret_cast<const char *>(dirs.data()), dirs.size() * sizeof(DirRecord)) &&
+        file.write(strings.data(), strings.size());
+    if (!ok || !file.commit()) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "cache file generation fail! need to check '%s'", path.c_str());
+        return false;
+    }
+
+    LOG_DEBUG(MEDIA_INDEXER_CACHE, "cache file '%s' written, %zu items, %zu directories",
+        path.c_str(), items.size(), dirs.size());
+    return true;
+}
+
+CacheFile::CacheFile() :
+    data_(nullptr),
+    length_(0),
+    header_(nullptr),
+    blocks_(nullptr),
+    items_(nullptr),
+    dirs_(nullptr),
+    strings_(nullptr)
+{
+    // nothing to be done here
+}
+
+CacheFile::~CacheFile()
+{
+    close();
+}
+
+bool CacheFile::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to map '%s', error message : '%s'",
+            path.c_str(), strerror(errno));
+        return false;
+    }
+    data_ = static_cast<const char *>(addr);
+    length_ = st.st_size;
+
+    header_ = reinterpret_cast<const Header *>(data_);
+    if (memcmp(header_->magic, CACHE_FILE_MAGIC, sizeof(header_->magic)) ||
+        header_->version != CACHE_FILE_VERSION) {
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "'%s' is no cache file of version %d", path.c_str(),
+            CACHE_FILE_VERSION);
+        close();
+        return false;
+    }
+
+    // the item blocks are checked when they are used, everything
+    // else right away
+    uint64_t blocks = (static_cast<uint64_t>(header_->itemCount) + CACHE_FILE_BLOCK_ITEMS - 1) /
+        CACHE_FILE_BLOCK_ITEMS;
+    uint64_t expected = sizeof(Header) + header_->blockCount * sizeof(Block) +
+        static_cast<uint64_t>(header_->itemCount) * sizeof(ItemRecord) +
+        static_cast<uint64_t>(header_->dirCount) * sizeof(DirRecord) + header_->stringsSize;
+    bool ok = blocks == header_->blockCount && expected == length_ &&
+        header_->itemStringsSize <= header_->stringsSize;
+    if (ok) {
+        blocks_ = reinterpret_cast<const Block *>(data_ + sizeof(Header));
+        items_ = reinterpret_cast<const ItemRecord *>(blocks_ + header_->blockCount);
+        dirs_ = reinterpret_cast<const DirRecord *>(items_ + header_->itemCount);
+        strings_ = reinterpret_cast<const char *>(dirs_ + header_->dirCount);
+        ok = checksum(reinterpret_cast<const char *>(blocks_), header_->blockCount * sizeof(Block)) ==
+            header_->blockChecksum;
+        for (uint32_t block = 0; ok && block < header_->blockCount; ++block) {
+            auto begin = block ? blocks_[block - 1].stringsEnd : 0;
+            ok = begin <= blocks_[block].stringsEnd;
+        }
+        ok = ok && (!blocks || blocks_[blocks - 1].stringsEnd == header_->itemStringsSize);
+    }
+    if (ok) {
+        auto sum = checksum(reinterpret_cast<const char *>(dirs_), header_->dirCount * sizeof(DirRecord));
+        ok = checksum(strings_ + header_->itemStringsSize, header_->stringsSize - header_->itemStringsSize,
+            sum) == header_->dirChecksum;
+    }
+    if (!ok) {
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "cache file '%s' is damaged", path.c_str());
+        close();
+        return false;
+    }
+
+    blockState_.reset(new std::atomic<uint8_t>[blocks]());
+    return true;
+}
+
+void CacheFile::close()
+{
+    if (data_)
+        munmap(const_cast<char *>(data_), length_);
+    data_ = nullptr;
+    length_ = 0;
+    header_ = nullptr;
+    blocks_ = nullptr;
+    blockState_.reset();
+    items_ = nullptr;
+    dirs_ = nullptr;
+    strings_ = nullptr;
+}
+
+bool CacheFile::isOpen() const
+{
+    return data_ != nullptr;
+}
+
+bool CacheFile::complete() const
+{
+    return header_ && (header_->flags & CACHE_FILE_COMPLETE);
+}
+
+size_t CacheFile::itemCount() const
+{
+    return header_ ? header_->itemCount : 0;
+}
+
+CacheFile::Item CacheFile::item(size_t idx) const
+{
+    const auto &rec = items_[idx];
+    return {stringAt(rec.pathOffset, rec.pathLength), stringAt(rec.thumbnailOffset, rec.thumbnailLength),
+        rec.hash, rec.size, rec.inode, static_cast<MediaItem::Type>(rec.type),
+        !!(rec.flags & CACHE_ITEM_PENDING)};
+}
+
+bool CacheFile::verified(size_t idx) const
+{
+    auto block = idx / CACHE_FILE_BLOCK_ITEMS;
+    auto state = blockState_[block].load();
+    if (state)
+        return state == 1;
+
+    // checking a block twice from two threads does no harm
+    auto first = block * CACHE_FILE_BLOCK_ITEMS;
+    auto count = std::min<size_t>(CACHE_FILE_BLOCK_ITEMS, itemCount() - first);
+    auto begin = block ? blocks_[block - 1].stringsEnd : 0;
+    auto sum = checksum(reinterpret_cast<const char *>(items_ + first), count * sizeof(ItemRecord));
+    bool good = checksum(strings_ + begin, blocks_[block].stringsEnd - begin, sum) == blocks_[block].checksum;
+    if (!good)
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "cache file items %zu to %zu are damaged", first, first + count);
+    blockState_[block] = good ? 1 : 2;
+    return good;
+}
+
+std::optional<CacheFile::Item> CacheFile::findItem(std::string_view path) const
+{
+    auto end = items_ + itemCount();
+    auto iter = std::lower_bound(items_, end, path, [this] (const ItemRecord &rec, std::string_view key) {
+        return stringAt(rec.pathOffset, rec.pathLength) < key;
+    });
+    if (iter == end || stringAt(iter->pathOffset, iter->pathLength) != path || !verified(iter - items_))
+        return std::nullopt;
+    return item(iter - items_);
+}
+
+size_t CacheFile::dirCount() const
+{
+    return header_ ? header_->dirCount : 0;
+}
+
+CacheFile::Dir CacheFile::dir(size_t idx) const
+{
+    const auto &rec = dirs_[idx];
+    return {stringAt(rec.pathOffset, rec.pathLength), rec.hash, rec.count};
+}
+
+std::optional<CacheFile::Dir> CacheFile::findDir(std::string_view path) const
+{
+    auto end = dirs_ + dirCount();
+    auto iter = std::lower_bound(dirs_, end, path, [this] (const DirRecord &rec, std::string_view key) {
+        return stringAt(rec.pathOffset, rec.pathLength) < key;
+    });
+    if (iter == end || stringAt(iter->pathOffset, iter->pathLength) != path)
+        return std::nullopt;
+    return dir(iter - dirs_);
+}
+
+std::string_view CacheFile::stringAt(uint32_t offset, uint32_t length) const
+{
+    // the checksum only tells us the file is as written, not that the
+    // writer was right
+    if (static_cast<uint64_t>(offset) + length > header_->stringsSize)
+        return std::string_view();
+    return std::string_view(strings_ + offset, length);
+}
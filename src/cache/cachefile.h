@@ -0,0 +1,163 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "mediaitem.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * \brief Binary device cache file.
+ *
+ * The file consists of a header, a block table, fixed width item and
+ * directory records sorted by path and a string table the records
+ * point into. It is mapped read only, records are accessed in place
+ * and single paths can be looked up with a binary search without
+ * loading the whole file. Numbers are stored in host byte order, the
+ * file never leaves the device it has been written on.
+ *
+ * Opening only checks the layout, the block table and the directory
+ * records. The items are checksummed in blocks along with their
+ * strings, a block is checked on first use with verified(), so a
+ * large file is not read completely before the scan can start.
+ *
+ * The file is not compressed. A compressed string table could not be
+ * accessed in place, it would have to be unpacked completely before
+ * the first lookup.
+ */
+class CacheFile
+{
+public:
+    /// Media item record.
+    struct Item {
+        std::string_view path;
+        std::string_view thumbnail;
+        unsigned long hash;
+        unsigned long size;
+        unsigned long inode;
+        MediaItem::Type type;
+        /// The item may not be in the database yet.
+        bool pending;
+    };
+
+    /// Directory record.
+    struct Dir {
+        std::string_view path;
+        unsigned long hash;
+        /// Number of files and subdirectories stored along with it.
+        unsigned long count;
+    };
+
+    /// Collects records and writes a cache file.
+    class Writer
+    {
+    public:
+        void addItem(std::string_view path, unsigned long hash, MediaItem::Type type,
+            std::string_view thumbnail, unsigned long size, unsigned long inode, bool pending);
+        void addDir(std::string_view path, unsigned long hash, unsigned long count);
+
+        /**
+         * \brief Write the collected records.
+         *
+         * \param[in] path The cache file path.
+         * \param[in] complete The records describe a finished scan.
+         * \return True on success, else false.
+         */
+        bool write(const std::string &path, bool complete);
+
+    private:
+        struct PendingItem {
+            std::string path;
+            std::string thumbnail;
+            unsigned long hash;
+            unsigned long size;
+            unsigned long inode;
+            MediaItem::Type type;
+            bool pending;
+        };
+        std::vector<PendingItem> items_;
+        std::vector<std::pair<std::string, std::pair<unsigned long, unsigned long>>> dirs_;
+    };
+
+    CacheFile();
+    ~CacheFile();
+
+    CacheFile(const CacheFile &) = delete;
+    CacheFile &operator=(const CacheFile &) = delete;
+
+    /**
+     * \brief Map a cache file and check it.
+     *
+     * \param[in] path The cache file path.
+     * \return False if the file does not exist, is no cache file of
+     * this version or is damaged, else true.
+     */
+    bool open(const std::string &path);
+
+    /// Unmap the file, all views handed out become invalid.
+    void close();
+
+    /// A file is mapped.
+    bool isOpen() const;
+
+    /// The file describes a finished scan.
+    bool complete() const;
+
+    size_t itemCount() const;
+    /// Item record, not checked, see verified().
+    Item item(size_t idx) const;
+    /**
+     * \brief Check the block of an item record.
+     *
+     * \param[in] idx The item position.
+     * \return False if the block the item belongs to is damaged, else
+     * true.
+     */
+    bool verified(size_t idx) const;
+    std::optional<Item> findItem(std::string_view path) const;
+
+    size_t dirCount() const;
+    Dir dir(size_t idx) const;
+    std::optional<Dir> findDir(std::string_view path) const;
+
+private:
+    struct Header;
+    struct Block;
+    struct ItemRecord;
+    struct DirRecord;
+
+    std::string_view stringAt(uint32_t offset, uint32_t length) const;
+
+    /// Mapped file.
+    const char *data_;
+    size_t length_;
+
+    const Header *header_;
+    const Block *blocks_;
+    const ItemRecord *items_;
+    const DirRecord *dirs_;
+    const char *strings_;
+
+    /// Check state per block, 0 unknown, 1 good, 2 damaged.
+    mutable std::unique_ptr<std::atomic<uint8_t>[]> blockState_;
+};
@@ -0,0 +1,258 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "cacheindex.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+std::pair<std::string_view, std::string_view> splitPath(std::string_view path)
+{
+    auto pos = path.find_last_of('/');
+    if (pos == std::string_view::npos)
+        return std::make_pair(std::string_view(), path);
+    return std::make_pair(path.substr(0, pos), path.substr(pos + 1));
+}
+
+} // namespace
+
+CacheIndex::CacheIndex()
+{
+    // nothing to be done here
+}
+
+CacheIndex::~CacheIndex()
+{
+    // nothing to be done here
+}
+
+void CacheIndex::addItem(std::string_view path, unsigned long hash, MediaItem::Type type,
+    std::string_view thumbnail, unsigned long size, unsigned long inode, bool pending)
+{
+    auto parts = splitPath(path);
+    Item item;
+    item.hash = hash;
+    item.size = size;
+    item.inode = inode;
+    item.dir = internDir(parts.first);
+    item.nameLength = static_cast<uint16_t>(parts.second.size());
+    item.name = addString(parts.second);
+    item.thumbnailLength = static_cast<uint16_t>(thumbnail.size());
+    item.thumbnail = addString(thumbnail);
+    item.type = type;
+    item.pending = pending;
+    items_.push_back(item);
+}
+
+void CacheIndex::addDir(std::string_view path, unsigned long hash, unsigned long count)
+{
+    auto &dir = dirs_[internDir(path)];
+    dir.hash = hash;
+    dir.count = count;
+    dir.known = true;
+}
+
+uint32_t CacheIndex::addString(std::string_view str)
+{
+    auto offset = static_cast<uint32_t>(strings_.size());
+    strings_.append(str);
+    return offset;
+}
+
+uint32_t CacheIndex::internDir(std::string_view path)
+{
+    // items usually come directory by directory
+    if (!dirs_.empty() && dirPath(lastDir_) == path)
+        return lastDir_;
+
+    auto iter = dirIds_.find(std::string(path));
+    if (iter != dirIds_.end())
+        return lastDir_ = iter->second;
+
+    Dir dir = {};
+    dir.pathLength = static_cast<uint32_t>(path.size());
+    dir.path = addString(path);
+    auto idx = static_cast<uint32_t>(dirs_.size());
+    dirs_.push_back(dir);
+    dirIds_.emplace(path, idx);
+    return lastDir_ = idx;
+}
+
+void CacheIndex::build()
+{
+    // the lookup below points into strings_, it must not move anymore
+    strings_.shrink_to_fit();
+    items_.shrink_to_fit();
+
+    // directories in path order, the items of a directory in name order
+    std::vector<uint32_t> order(dirs_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this] (uint32_t a, uint32_t b) {
+        return dirPath(a) < dirPath(b);
+    });
+    std::vector<uint32_t> position(dirs_.size());
+    std::vector<Dir> dirs;
+    dirs.reserve(dirs_.size());
+    for (auto idx : order) {
+        position[idx] = static_cast<uint32_t>(dirs.size());
+        dirs.push_back(dirs_[idx]);
+    }
+    dirs_ = std::move(dirs);
+    dirIds_.clear();
+    lastDir_ = 0;
+
+    for (auto &item : items_)
+        item.dir = position[item.dir];
+    std::sort(items_.begin(), items_.end(), [this] (const Item &a, const Item &b) {
+        if (a.dir != b.dir)
+            return a.dir < b.dir;
+        return std::string_view(strings_.data() + a.name, a.nameLength) <
+            std::string_view(strings_.data() + b.name, b.nameLength);
+    });
+
+    dirLookup_.clear();
+    dirLookup_.reserve(dirs_.size());
+    for (uint32_t idx = 0; idx < dirs_.size(); ++idx) {
+        dirLookup_.emplace(dirPath(idx), idx);
+        dirs_[idx].firstItem = dirs_[idx].endItem = 0;
+        dirs_[idx].pending = false;
+    }
+    for (uint32_t idx = 0; idx < items_.size(); ++idx) {
+        auto &dir = dirs_[items_[idx].dir];
+        if (dir.endItem == 0)
+            dir.firstItem = idx;
+        dir.endItem = idx + 1;
+        dir.pending |= items_[idx].pending;
+    }
+
+    // items which may not be in the database can not have been moved
+    hashItems_.clear();
+    for (uint32_t idx = 0; idx < items_.size(); ++idx) {
+        if (items_[idx].size && !items_[idx].pending)
+            hashItems_.push_back(idx);
+    }
+    std::sort(hashItems_.begin(), hashItems_.end(), [this] (uint32_t a, uint32_t b) {
+        return items_[a].hash < items_[b].hash;
+    });
+    hashes_.resize(hashItems_.size());
+    for (size_t idx = 0; idx < hashItems_.size(); ++idx)
+        hashes_[idx] = items_[hashItems_[idx]].hash;
+}
+
+void CacheIndex::clear()
+{
+    strings_.clear();
+    items_.clear();
+    dirs_.clear();
+    lastDir_ = 0;
+    dirIds_.clear();
+    dirLookup_.clear();
+    hashes_.clear();
+    hashItems_.clear();
+}
+
+size_t CacheIndex::size() const
+{
+    return items_.size();
+}
+
+const CacheIndex::Item &CacheIndex::item(uint32_t idx) const
+{
+    return items_[idx];
+}
+
+std::string_view CacheIndex::name(uint32_t idx) const
+{
+    return std::string_view(strings_.data() + items_[idx].name, items_[idx].nameLength);
+}
+
+std::string_view CacheIndex::thumbnail(uint32_t idx) const
+{
+    return std::string_view(strings_.data() + items_[idx].thumbnail, items_[idx].thumbnailLength);
+}
+
+std::string CacheIndex::path(uint32_t idx) const
+{
+    auto dir = dirPath(items_[idx].dir);
+    auto file = name(idx);
+    std::string path;
+    path.reserve(dir.size() + file.size() + 1);
+    path.append(dir).append("/").append(file);
+    return path;
+}
+
+uint32_t CacheIndex::findItem(std::string_view path) const
+{
+    auto parts = splitPath(path);
+    auto dir = findDir(parts.first);
+    if (dir == npos)
+        return npos;
+
+    auto first = items_.begin() + dirs_[dir].firstItem;
+    auto last = items_.begin() + dirs_[dir].endItem;
+    auto iter = std::lower_bound(first, last, parts.second, [this] (const Item &item, std::string_view key) {
+        return std::string_view(strings_.data() + item.name, item.nameLength) < key;
+    });
+    if (iter == last || std::string_view(strings_.data() + iter->name, iter->nameLength) != parts.second)
+        return npos;
+    return static_cast<uint32_t>(iter - items_.begin());
+}
+
+size_t CacheIndex::dirCount() const
+{
+    return dirs_.size();
+}
+
+const CacheIndex::Dir &CacheIndex::dir(uint32_t idx) const
+{
+    return dirs_[idx];
+}
+
+std::string_view CacheIndex::dirPath(uint32_t idx) const
+{
+    return std::string_view(strings_.data() + dirs_[idx].path, dirs_[idx].pathLength);
+}
+
+uint32_t CacheIndex::findDir(std::string_view path) const
+{
+    auto iter = dirLookup_.find(path);
+    return iter == dirLookup_.end() ? npos : iter->second;
+}
+
+uint32_t CacheIndex::lowerBoundDir(std::string_view path) const
+{
+    uint32_t first = 0;
+    uint32_t count = static_cast<uint32_t>(dirs_.size());
+    while (count > 0) {
+        auto step = count / 2;
+        if (dirPath(first + step) < path) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+std::pair<const uint32_t *, const uint32_t *> CacheIndex::itemsByHash(unsigned long hash) const
+{
+    auto range = std::equal_range(hashes_.begin(), hashes_.end(), hash);
+    return std::make_pair(hashItems_.data() + (range.first - hashes_.begin()),
+        hashItems_.data() + (range.second - hashes_.begin()));
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "mediaitem.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Compact read only index of the cached items of a device.
+ *
+ * Paths are split into directory and file name. Every directory path
+ * is stored once, an item only keeps the index of its directory and
+ * its file name. All strings live in a single buffer. Items are
+ * sorted by directory and name, so the items of a directory are
+ * adjacent and a path is found with one hash lookup for the directory
+ * and a binary search on the names without allocating anything.
+ *
+ * Splitting the paths is the prefix compression of the index, an
+ * item shares its whole directory prefix with its siblings and keeps
+ * nothing but its name. Directory paths are not front coded against
+ * each other. There are far fewer of them than items, so this would
+ * save little, and lookups and range scans would have to rebuild the
+ * paths instead of comparing views into the buffer.
+ *
+ * Fill with addItem() and addDir(), then call build(). The index
+ * can not be changed afterwards, items are referred to by position.
+ */
+class CacheIndex
+{
+public:
+    /// Invalid position.
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    /// Cached item.
+    struct Item {
+        unsigned long hash;
+        unsigned long size;
+        unsigned long inode;
+        uint32_t dir;
+        uint32_t name;
+        uint32_t thumbnail;
+        uint16_t nameLength;
+        uint16_t thumbnailLength;
+        MediaItem::Type type;
+        /// The item may not be in the database yet.
+        bool pending;
+    };
+
+    /// Directory, either stored with its state or parent of an item.
+    struct Dir {
+        uint32_t path;
+        uint32_t pathLength;
+        /// Items of this directory.
+        uint32_t firstItem;
+        uint32_t endItem;
+        /// Modification hash and entry count, valid if known.
+        unsigned long hash;
+        unsigned long count;
+        bool known;
+        /// Some items may not be in the database yet.
+        bool pending;
+    };
+
+    CacheIndex();
+    ~CacheIndex();
+
+    void addItem(std::string_view path, unsigned long hash, MediaItem::Type type,
+        std::string_view thumbnail, unsigned long size, unsigned long inode, bool pending);
+    void addDir(std::string_view path, unsigned long hash, unsigned long count);
+
+    /// Sort and index everything added so far.
+    void build();
+
+    /// Drop everything.
+    void clear();
+
+    size_t size() const;
+    const Item &item(uint32_t idx) const;
+    std::string_view name(uint32_t idx) const;
+    std::string_view thumbnail(uint32_t idx) const;
+    /// Full path of an item.
+    std::string path(uint32_t idx) const;
+    /// Position of an item or npos.
+    uint32_t findItem(std::string_view path) const;
+
+    size_t dirCount() const;
+    const Dir &dir(uint32_t idx) const;
+    std::string_view dirPath(uint32_t idx) const;
+    /// Position of a directory or npos.
+    uint32_t findDir(std::string_view path) const;
+    /// First directory whose path is not less than path.
+    uint32_t lowerBoundDir(std::string_view path) const;
+
+    /// Items with the given hash, used to find moved files.
+    std::pair<const uint32_t *, const uint32_t *> itemsByHash(unsigned long hash) const;
+
+private:
+    uint32_t addString(std::string_view str);
+    uint32_t internDir(std::string_view path);
+
+    /// All strings.
+    std::string strings_;
+    std::vector<Item> items_;
+    std::vector<Dir> dirs_;
+    /// Directory path to position while filling, strings_ may still move.
+    std::unordered_map<std::string, uint32_t> dirIds_;
+    uint32_t lastDir_ = 0;
+    /// Directory path to position once built, keys point into strings_.
+    std::unordered_map<std::string_view, uint32_t> dirLookup_;
+    /// Items with size sorted by hash and hashes_ along with them.
+    std::vector<unsigned long> hashes_;
+    std::vector<uint32_t> hashItems_;
+};
@@ -0,0 +1,265 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "cachejournal.h"
+#include "durablefile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/// File magic and format version, written once at the start.
+#define CACHE_JOURNAL_MAGIC "MIDXJRNL"
+#define CACHE_JOURNAL_MAGIC_SIZE 8
+
+namespace {
+
+uint32_t checksum(const char *data, size_t length)
+{
+    uint32_t sum = 2166136261u;
+    for (size_t idx = 0; idx < length; ++idx) {
+        sum ^= static_cast<unsigned char>(data[idx]);
+        sum *= 16777619u;
+    }
+    return sum;
+}
+
+template<typename T>
+void put(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void putString(std::string &out, const std::string &str)
+{
+    put<uint32_t>(out, str.size());
+    out.append(str);
+}
+
+/// Reads fields from a record payload, fails on short payloads.
+class Reader
+{
+public:
+    Reader(const char *data, size_t length) : data_(data), left_(length) {}
+
+    template<typename T>
+    bool get(T &value)
+    {
+        if (left_ < sizeof(T))
+            return false;
+        memcpy(&value, data_, sizeof(T));
+        data_ += sizeof(T);
+        left_ -= sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string &str)
+    {
+        uint32_t len;
+        if (!get(len) || left_ < len)
+            return false;
+        str.assign(data_, len);
+        data_ += len;
+        left_ -= len;
+        return true;
+    }
+
+private:
+    const char *data_;
+    size_t left_;
+};
+
+} // namespace
+
+CacheJournal::CacheJournal(const std::string &path) :
+    path_(path),
+    fd_(-1),
+    length_(0)
+{
+    // nothing to be done here
+}
+
+CacheJournal::~CacheJournal()
+{
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+void CacheJournal::appendItem(const std::string &path, unsigned long hash, MediaItem::Type type,
+    const std::string &thumbnail, unsigned long size, unsigned long inode)
+{
+    std::string payload;
+    put<uint8_t>(payload, static_cast<uint8_t>(Record::Type::Item));
+    put<uint64_t>(payload, hash);
+    put<uint64_t>(payload, size);
+    put<uint64_t>(payload, inode);
+    put<int32_t>(payload, static_cast<int32_t>(type));
+    putString(payload, path);
+    putString(payload, thumbnail);
+    append(payload);
+}
+
+void CacheJournal::appendRemove(const std::string &path)
+{
+    std::string payload;
+    put<uint8_t>(payload, static_cast<uint8_t>(Record::Type::Remove));
+    putString(payload, path);
+    append(payload);
+}
+
+void CacheJournal::append(const std::string &payload)
+{
+    put<uint32_t>(buffer_, payload.size());
+    put<uint32_t>(buffer_, checksum(payload.data(), payload.size()));
+    buffer_.append(payload);
+}
+
+bool CacheJournal::open()
+{
+    if (fd_ >= 0)
+        return true;
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to open journal '%s', error message : '%s'",
+            path_.c_str(), strerror(errno));
+        return false;
+    }
+
+    // cut off a torn record or a journal which belongs to an older
+    // cache file
+    if (ftruncate(fd_, length_) < 0 || lseek(fd_, length_, SEEK_SET) < 0) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to prepare journal '%s', error message : '%s'",
+            path_.c_str(), strerror(errno));
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    if (length_ == 0 && buffer_.compare(0, CACHE_JOURNAL_MAGIC_SIZE, CACHE_JOURNAL_MAGIC))
+        buffer_.insert(0, CACHE_JOURNAL_MAGIC, CACHE_JOURNAL_MAGIC_SIZE);
+    return true;
+}
+
+bool CacheJournal::flush()
+{
+    if (buffer_.empty())
+        return true;
+    if (!open())
+        return false;
+
+    if (!DurableFile::writeAll(fd_, buffer_.data(), buffer_.size())) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to write journal '%s', error message : '%s'",
+            path_.c_str(), strerror(errno));
+        // the next open() cuts off whatever made it to the file
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    bool created = length_ == 0;
+    length_ += buffer_.size();
+    buffer_.clear();
+
+    if (fdatasync(fd_) < 0) {
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "Failed to sync journal '%s', error message : '%s'",
+            path_.c_str(), strerror(errno));
+        return false;
+    }
+
+    // a new journal file is only found again once its directory
+    // entry is on the disk
+    if (created)
+        return DurableFile::syncDirectory(DurableFile::directory(path_));
+    return true;
+}
+
+size_t CacheJournal::replay(const std::function<void(Record &&)> &handler)
+{
+    length_ = 0;
+    std::ifstream in(path_, std::ios::binary);
+    if (!in.is_open())
+        return 0;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (data.size() < CACHE_JOURNAL_MAGIC_SIZE || data.compare(0, CACHE_JOURNAL_MAGIC_SIZE, CACHE_JOURNAL_MAGIC)) {
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "'%s' is no cache journal, ignore it", path_.c_str());
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t pos = CACHE_JOURNAL_MAGIC_SIZE;
+    while (data.size() - pos >= 2 * sizeof(uint32_t)) {
+        uint32_t len, sum;
+        memcpy(&len, data.data() + pos, sizeof(len));
+        memcpy(&sum, data.data() + pos + sizeof(len), sizeof(sum));
+        const char *payload = data.data() + pos + 2 * sizeof(uint32_t);
+        if (data.size() - pos - 2 * sizeof(uint32_t) < len || checksum(payload, len) != sum)
+            break;
+
+        Reader reader(payload, len);
+        Record rec;
+        uint8_t type;
+        bool valid = reader.get(type);
+        rec.type = static_cast<Record::Type>(type);
+        if (valid && rec.type == Record::Type::Item) {
+            uint64_t hash, size, inode;
+            int32_t mediaType;
+            valid = reader.get(hash) && reader.get(size) && reader.get(inode) && reader.get(mediaType) &&
+                reader.getString(rec.path) && reader.getString(rec.thumbnail);
+            rec.hash = hash;
+            rec.size = size;
+            rec.inode = inode;
+            rec.mediaType = static_cast<MediaItem::Type>(mediaType);
+        } else if (valid && rec.type == Record::Type::Remove) {
+            valid = reader.getString(rec.path);
+        } else {
+            valid = false;
+        }
+        if (!valid)
+            break;
+
+        handler(std::move(rec));
+        pos += 2 * sizeof(uint32_t) + len;
+        count++;
+    }
+
+    if (pos != data.size())
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "journal '%s' is truncated after %zu records", path_.c_str(), count);
+    length_ = pos;
+    return count;
+}
+
+void CacheJournal::discard()
+{
+    if (fd_ >= 0)
+        close(fd_);
+    fd_ = -1;
+    length_ = 0;
+    buffer_.clear();
+    // the removal must be on the disk before new records go to a new
+    // journal, else a crash could bring back the old records
+    UnlinkBatch journal;
+    journal.add(path_);
+    journal.commit();
+}
+
+size_t CacheJournal::size() const
+{
+    return length_ + buffer_.size();
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "mediaitem.h"
+
+#include <functional>
+#include <string>
+
+/// journal file next to the cache file
+#define CACHE_JOURNAL_SUFFIX ".journal"
+
+/**
+ * \brief Append-only change journal of a device cache.
+ *
+ * Records the changes a scan makes to the cache since the cache file
+ * has been written last. Records are collected in memory and written
+ * in one go on flush(). Each record carries a checksum so a record
+ * torn by a crash ends the replay instead of corrupting the cache.
+ */
+class CacheJournal
+{
+public:
+    /// Journal record.
+    struct Record {
+        enum class Type : uint8_t {
+            Item = 1,  ///< Item has been added or updated.
+            Remove = 2 ///< Item or directory with everything below has been removed.
+        };
+        Type type;
+        std::string path;
+        std::string thumbnail;
+        unsigned long hash;
+        unsigned long size;
+        unsigned long inode;
+        MediaItem::Type mediaType;
+    };
+
+    /**
+     * \brief Construct journal.
+     *
+     * \param[in] path The journal file path.
+     */
+    CacheJournal(const std::string &path);
+    ~CacheJournal();
+
+    CacheJournal(const CacheJournal &) = delete;
+    CacheJournal &operator=(const CacheJournal &) = delete;
+
+    /// Record an added or updated item.
+    void appendItem(const std::string &path, unsigned long hash, MediaItem::Type type,
+        const std::string &thumbnail, unsigned long size, unsigned long inode);
+
+    /// Record a removed item or directory.
+    void appendRemove(const std::string &path);
+
+    /**
+     * \brief Write the collected records and wait until they are on
+     * the disk.
+     *
+     * \return True on success, else false.
+     */
+    bool flush();
+
+    /**
+     * \brief Read all intact records from the journal file.
+     *
+     * Records appended afterwards continue behind the last intact
+     * record.
+     *
+     * \param[in] handler Called for each record in order.
+     * \return Number of records read.
+     */
+    size_t replay(const std::function<void(Record &&)> &handler);
+
+    /// Drop the journal file and all collected records, the removal
+    /// is durable when this returns.
+    void discard();
+
+    /// Journal size in bytes including records not yet written.
+    size_t size() const;
+
+private:
+    /// Open the journal file for appending.
+    bool open();
+
+    /// Append a record with length and checksum to the buffer.
+    void append(const std::string &payload);
+
+    std::string path_;
+    int fd_;
+    /// Length of the journal file.
+    size_t length_;
+    /// Records not yet written.
+    std::string buffer_;
+};
@@ -15,6 +15,8 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "cachemanager.h"
+#include "durablefile.h"
+#include <filesystem>
 
 std::unique_ptr<CacheManager> CacheManager::instance_;
 
@@ -49,9 +51,10 @@ std::shared_ptr<Cache> CacheManager::createCache(const std::string& devUri, cons
     }
     */
     createCacheDirectory(uuid);
-    std::string cachePath = CACHE_DIRECTORY + uuid + std::string("/") + std::string(CACHE_JSONFILE);
+    std::string cachePath = cacheFilePath(uuid);
     auto cache = std::make_shared<Cache>(cachePath);
-    caches_.emplace(devUri, cache);
+    // a cache read before is replaced
+    caches_[devUri] = cache;
     return cache;
 }
 
@@ -79,17 +82,35 @@ bool CacheManager::generateCacheFile(const std::string& devUri,
 std::shared_ptr<Cache> CacheManager::readCache(const std::string& devUri, const std::string& uuid)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string cachePath = CACHE_DIRECTORY + uuid + std::string("/") + std::string(CACHE_JSONFILE);
+    std::string cachePath = cacheFilePath(uuid);
     auto cache = std::make_shared<Cache>(cachePath);
     bool ret = cache->readCache();
     if (!ret) {
         LOG_WARNING(MEDIA_INDEXER_CACHEMANAGER, 0, "Failed to read cache file!");
         return nullptr;
     }
-    caches_.emplace(devUri, cache);
+    caches_[devUri] = cache;
     return cache;
 }
 
+void CacheManager::releaseCache(const std::string& devUri)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    caches_.erase(devUri);
+}
+
+void CacheManager::commitCache(const std::string& uuid)
+{
+    // everything the last scan has passed on is in the database now,
+    // the next read can trust all items of the cache file
+    std::string cachePath = cacheFilePath(uuid);
+    if (!std::filesystem::exists(cachePath))
+        return;
+    DurableFile marker(cachePath + CACHE_COMMIT_SUFFIX);
+    if (!marker.commit())
+        LOG_WARNING(MEDIA_INDEXER_CACHEMANAGER, 0, "Failed to commit cache '%s'", cachePath.c_str());
+}
+
 void CacheManager::resetCache(const std::string& path)
 {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -113,6 +134,11 @@ void CacheManager::resetAllCache()
     caches_.clear();
 }
 
+std::string CacheManager::cacheFilePath(const std::string& uuid) const
+{
+    return CACHE_DIRECTORY + uuid + std::string("/") + std::string(CACHE_FILE);
+}
+
 void CacheManager::createCacheDirectory(const std::string& uuid)
 {
     std::error_code err;
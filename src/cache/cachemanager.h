@@ -34,9 +34,13 @@ public:
     int totalSize();
     bool generateCacheFile(const std::string& devUri, const std::shared_ptr<Cache>& cache);
     std::shared_ptr<Cache> readCache(const std::string& devUri, const std::string& uuid);
+    /// forget a cache which is not used, the files are kept
+    void releaseCache(const std::string& devUri);
     void resetCache(const std::string& path);
+    void commitCache(const std::string& uuid);
     void resetAllCache();
     void createCacheDirectory(const std::string& uuid);
+    std::string cacheFilePath(const std::string& uuid) const;
     void printAllCache() const;
 
  private:
@@ -0,0 +1,165 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "durablefile.h"
+#include "logging.h"
+
+#include <cstring>
+#include <set>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+DurableFile::DurableFile(const std::string &path) :
+    path_(path),
+    tmpPath_(path + ".tmp"),
+    fd_(-1),
+    failed_(false)
+{
+    // nothing to be done here
+}
+
+DurableFile::~DurableFile()
+{
+    if (fd_ >= 0) {
+        close(fd_);
+        unlink(tmpPath_.c_str());
+    }
+}
+
+bool DurableFile::open()
+{
+    if (fd_ >= 0)
+        return true;
+
+    fd_ = ::open(tmpPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to create '%s', error message : '%s'",
+            tmpPath_.c_str(), strerror(errno));
+        return false;
+    }
+    failed_ = false;
+    return true;
+}
+
+bool DurableFile::write(const char *data, size_t length)
+{
+    if (!open())
+        return false;
+    if (!writeAll(fd_, data, length)) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to write '%s', error message : '%s'",
+            tmpPath_.c_str(), strerror(errno));
+        failed_ = true;
+    }
+    return !failed_;
+}
+
+bool DurableFile::commit()
+{
+    if (!open())
+        return false;
+
+    // the old file stays in place until the new one is on the disk
+    bool ok = !failed_ && fdatasync(fd_) == 0;
+    close(fd_);
+    fd_ = -1;
+    if (!ok || rename(tmpPath_.c_str(), path_.c_str()) < 0) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to replace '%s', error message : '%s'",
+            path_.c_str(), strerror(errno));
+        unlink(tmpPath_.c_str());
+        return false;
+    }
+
+    // make the rename itself durable
+    return syncDirectory(directory(path_));
+}
+
+bool DurableFile::writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0) {
+        ssize_t ret = ::write(fd, data, length);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return false;
+        data += ret;
+        length -= ret;
+    }
+    return true;
+}
+
+bool DurableFile::syncDirectory(const std::string &dir)
+{
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "Failed to open directory '%s', error message : '%s'",
+            dir.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    if (!ok)
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "Failed to sync directory '%s', error message : '%s'",
+            dir.c_str(), strerror(errno));
+    close(fd);
+    return ok;
+}
+
+std::string DurableFile::directory(const std::string &path)
+{
+    auto pos = path.find_last_of('/');
+    if (pos == std::string::npos)
+        return std::string();
+    return path.substr(0, pos + 1);
+}
+
+UnlinkBatch::UnlinkBatch()
+{
+    // nothing to be done here
+}
+
+UnlinkBatch::~UnlinkBatch()
+{
+    commit();
+}
+
+void UnlinkBatch::add(const std::string &path)
+{
+    paths_.push_back(path);
+}
+
+size_t UnlinkBatch::commit()
+{
+    size_t failed = 0;
+    std::set<std::string> dirs;
+    for (const auto &path : paths_) {
+        if (unlink(path.c_str()) < 0) {
+            if (errno != ENOENT) {
+                LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to remove '%s', error message : '%s'",
+                    path.c_str(), strerror(errno));
+                failed++;
+            }
+            continue;
+        }
+        dirs.insert(DurableFile::directory(path));
+    }
+    paths_.clear();
+
+    for (const auto &dir : dirs)
+        DurableFile::syncDirectory(dir);
+    return failed;
+}
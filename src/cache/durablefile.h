@@ -0,0 +1,103 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Replaces a file atomically and durably.
+ *
+ * Data goes to a temporary file next to the target. commit() syncs
+ * the temporary file, renames it over the target and syncs the
+ * directory, so after a crash either the old or the new file is
+ * found. Only the files involved are synced, unlike sync() which
+ * flushes every file system.
+ */
+class DurableFile
+{
+public:
+    /**
+     * \brief Construct writer.
+     *
+     * \param[in] path The target file path.
+     */
+    DurableFile(const std::string &path);
+
+    /// Removes the temporary file unless committed.
+    ~DurableFile();
+
+    DurableFile(const DurableFile &) = delete;
+    DurableFile &operator=(const DurableFile &) = delete;
+
+    /// Create the temporary file.
+    bool open();
+
+    /// Append data to the temporary file.
+    bool write(const char *data, size_t length);
+
+    /**
+     * \brief Replace the target with the data written so far.
+     *
+     * \return True once the new file is on the disk, else false.
+     */
+    bool commit();
+
+    /// Write all of data to fd, retries on interrupts.
+    static bool writeAll(int fd, const char *data, size_t length);
+
+    /**
+     * \brief Make the directory entries of a directory durable.
+     *
+     * \param[in] dir The directory path.
+     * \return True on success, else false.
+     */
+    static bool syncDirectory(const std::string &dir);
+
+    /// Directory part of path.
+    static std::string directory(const std::string &path);
+
+private:
+    std::string path_;
+    std::string tmpPath_;
+    int fd_;
+    bool failed_;
+};
+
+/**
+ * \brief Removes files and syncs each directory involved once.
+ */
+class UnlinkBatch
+{
+public:
+    UnlinkBatch();
+    ~UnlinkBatch();
+
+    /// Queue a file for removal.
+    void add(const std::string &path);
+
+    /**
+     * \brief Remove all queued files.
+     *
+     * \return Number of files which could not be removed.
+     */
+    size_t commit();
+
+private:
+    std::vector<std::string> paths_;
+};
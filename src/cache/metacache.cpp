@@ -0,0 +1,367 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "metacache.h"
+#include "durablefile.h"
+#include "device.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Bytes read from the start and from the end of a file.
+#define META_CACHE_SAMPLE_SIZE (64 * 1024)
+/// Cache file format version, bump on any change.
+#define META_CACHE_VERSION 1
+
+std::unique_ptr<MetaCache> MetaCache::instance_;
+
+namespace {
+
+uint64_t checksum(const char *data, size_t length, uint64_t sum = 14695981039346656037ull)
+{
+    for (size_t idx = 0; idx < length; ++idx) {
+        sum ^= static_cast<unsigned char>(data[idx]);
+        sum *= 1099511628211ull;
+    }
+    return sum;
+}
+
+bool readAll(int fd, char *data, size_t length, off_t offset)
+{
+    while (length > 0) {
+        ssize_t ret = pread(fd, data, length, offset);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+        data += ret;
+        length -= ret;
+        offset += ret;
+    }
+    return true;
+}
+
+/// These describe the file, not its content.
+bool fileSpecific(MediaItem::Meta meta)
+{
+    return meta == MediaItem::Meta::LastModifiedDate ||
+        meta == MediaItem::Meta::LastModifiedDateRaw ||
+        meta == MediaItem::Meta::FileSize;
+}
+
+std::string cacheFilePath()
+{
+    return std::string(META_CACHE_DIRECTORY) + META_CACHE_FILE;
+}
+
+} // namespace
+
+MetaCache *MetaCache::instance()
+{
+    if (!instance_.get())
+        instance_.reset(new MetaCache());
+    return instance_.get();
+}
+
+MetaCache::MetaCache() :
+    capacity_(0),
+    loaded_(false),
+    changes_(0)
+{
+    // nothing to be done here
+}
+
+MetaCache::~MetaCache()
+{
+    save();
+}
+
+void MetaCache::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    capacity_ = capacity;
+    if (capacity_ == 0)
+        return;
+    if (!loaded_)
+        load();
+    evict();
+}
+
+bool MetaCache::enabled() const
+{
+    return capacity_ > 0;
+}
+
+std::string MetaCache::fingerprint(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+        return std::string();
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return std::string();
+    }
+
+    // small files are taken as a whole, else head and tail
+    uint64_t size = st.st_size;
+    std::vector<char> buf(std::min<uint64_t>(size, 2 * META_CACHE_SAMPLE_SIZE));
+    bool ok;
+    if (size <= 2 * META_CACHE_SAMPLE_SIZE) {
+        ok = readAll(fd, buf.data(), buf.size(), 0);
+    } else {
+        ok = readAll(fd, buf.data(), META_CACHE_SAMPLE_SIZE, 0) &&
+            readAll(fd, buf.data() + META_CACHE_SAMPLE_SIZE, META_CACHE_SAMPLE_SIZE,
+                size - META_CACHE_SAMPLE_SIZE);
+    }
+    close(fd);
+    if (!ok)
+        return std::string();
+
+    char key[40];
+    snprintf(key, sizeof(key), "%" PRIx64 "-%016" PRIx64, size, checksum(buf.data(), buf.size()));
+    return key;
+}
+
+bool MetaCache::restore(const std::string &key, MediaItem &mediaItem)
+{
+    if (!enabled() || key.empty())
+        return false;
+
+    Entry entry;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = entries_.find(key);
+        if (iter == entries_.end())
+            return false;
+        lru_.splice(lru_.begin(), lru_, iter->second.lru);
+        entry.meta = iter->second.meta;
+        entry.thumbnail = iter->second.thumbnail;
+    }
+
+    // the thumbnail belongs to the device of the media item, it is
+    // removed along with the item
+    if (!entry.thumbnail.empty()) {
+        auto device = mediaItem.device();
+        if (!device || !device->createThumbnailDirectory())
+            return false;
+        auto name = std::filesystem::path(mediaItem.getThumbnailFileName()).stem().string() +
+            std::filesystem::path(entry.thumbnail).extension().string();
+        auto thumbnail = THUMBNAIL_DIRECTORY + mediaItem.uuid() + "/" + name;
+        std::error_code err;
+        if (!std::filesystem::copy_file(entry.thumbnail, thumbnail,
+                std::filesystem::copy_options::overwrite_existing, err)) {
+            LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "Failed to restore thumbnail '%s', error : %s",
+                entry.thumbnail.c_str(), err.message().c_str());
+            std::lock_guard<std::mutex> lock(lock_);
+            auto iter = entries_.find(key);
+            if (iter != entries_.end())
+                erase(iter);
+            return false;
+        }
+        mediaItem.setThumbnailFileName(name);
+        entry.meta[MediaItem::Meta::Thumbnail] = thumbnail;
+    }
+
+    for (auto &meta : entry.meta)
+        mediaItem.setMeta(meta.first, std::move(meta.second));
+    LOG_DEBUG(MEDIA_INDEXER_CACHE, "Meta data of '%s' restored from '%s'",
+        mediaItem.uri().c_str(), key.c_str());
+    return true;
+}
+
+void MetaCache::store(const std::string &key, const MediaItem &mediaItem)
+{
+    if (!enabled() || key.empty())
+        return;
+
+    Entry entry;
+    for (auto meta = MediaItem::Meta::Title; meta < MediaItem::Meta::EOL; ++meta) {
+        if (fileSpecific(meta))
+            continue;
+        auto data = mediaItem.meta(meta);
+        if (data)
+            entry.meta.emplace(meta, std::move(*data));
+    }
+
+    // keep a copy of the thumbnail, the one of the device goes with
+    // the device
+    auto thumbnail = entry.meta.find(MediaItem::Meta::Thumbnail);
+    if (thumbnail != entry.meta.end()) {
+        auto path = std::get_if<std::string>(&thumbnail->second);
+        if (path && !path->empty()) {
+            entry.thumbnail = META_CACHE_DIRECTORY + key + std::filesystem::path(*path).extension().string();
+            std::error_code err;
+            std::filesystem::create_directories(META_CACHE_DIRECTORY, err);
+            if (!std::filesystem::copy_file(*path, entry.thumbnail,
+                    std::filesystem::copy_options::overwrite_existing, err)) {
+                LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "Failed to keep thumbnail '%s', error : %s",
+                    path->c_str(), err.message().c_str());
+                return;
+            }
+            entry.meta.erase(thumbnail);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    auto iter = entries_.find(key);
+    if (iter != entries_.end()) {
+        entry.lru = iter->second.lru;
+        lru_.splice(lru_.begin(), lru_, entry.lru);
+        iter->second = std::move(entry);
+    } else {
+        lru_.push_front(key);
+        entry.lru = lru_.begin();
+        entries_.emplace(key, std::move(entry));
+        evict();
+    }
+    changes_++;
+}
+
+bool MetaCache::save()
+{
+    std::lock_guard<std::mutex> saveLock(saveLock_);
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!changes_)
+            return true;
+
+        // meta data is stored along with the variant index to get the
+        // very same type back
+        auto items = pbnjson::Array();
+        for (const auto &key : lru_) {
+            const auto &entry = entries_[key];
+            auto meta = pbnjson::Array();
+            for (const auto &field : entry.meta) {
+                auto value = pbnjson::Array();
+                value.append(static_cast<int32_t>(field.first));
+                value.append(static_cast<int32_t>(field.second.index()));
+                std::visit([&value] (auto &&arg) {
+                    using T = std::decay_t<decltype(arg)>;
+                    if constexpr (std::is_same_v<T, std::uint32_t>)
+                        value.append(static_cast<int64_t>(arg));
+                    else
+                        value.append(arg);
+                }, field.second);
+                meta.append(value);
+            }
+            auto item = pbnjson::Object();
+            item.put("key", key);
+            item.put("thumbnail", entry.thumbnail);
+            item.put("meta", meta);
+            items.append(item);
+        }
+        auto root = pbnjson::Object();
+        root.put("version", META_CACHE_VERSION);
+        root.put("entries", items);
+        data = root.stringify();
+        changes_ = 0;
+    }
+
+    std::error_code err;
+    std::filesystem::create_directories(META_CACHE_DIRECTORY, err);
+    DurableFile file(cacheFilePath());
+    if (!file.write(data.data(), data.size()) || !file.commit()) {
+        LOG_ERROR(MEDIA_INDEXER_CACHE, 0, "Failed to write meta cache '%s'", cacheFilePath().c_str());
+        return false;
+    }
+    return true;
+}
+
+void MetaCache::load()
+{
+    loaded_ = true;
+    auto path = cacheFilePath();
+    if (!std::filesystem::exists(path))
+        return;
+
+    auto root = pbnjson::JDomParser::fromFile(path.c_str());
+    if (!root.isObject() || !root.hasKey("version") || !root.hasKey("entries") ||
+        root["version"].asNumber<int32_t>() != META_CACHE_VERSION) {
+        LOG_WARNING(MEDIA_INDEXER_CACHE, 0, "Ignore meta cache '%s'", path.c_str());
+        return;
+    }
+
+    auto items = root["entries"];
+    for (int idx = 0; idx < items.arraySize(); idx++) {
+        auto item = items[idx];
+        auto key = item["key"].asString();
+        if (key.empty() || entries_.find(key) != entries_.end())
+            continue;
+        Entry entry;
+        entry.thumbnail = item["thumbnail"].asString();
+        auto meta = item["meta"];
+        for (int pos = 0; pos < meta.arraySize(); pos++) {
+            auto value = meta[pos];
+            if (value.arraySize() != 3)
+                continue;
+            auto type = static_cast<MediaItem::Meta>(value[0].asNumber<int32_t>());
+            if (type < MediaItem::Meta::Title || type >= MediaItem::Meta::EOL)
+                continue;
+            MediaItem::MetaData data;
+            switch (value[1].asNumber<int32_t>()) {
+            case 0: data = value[2].asNumber<int64_t>(); break;
+            case 1: data = value[2].asNumber<double>(); break;
+            case 2: data = value[2].asNumber<int32_t>(); break;
+            case 3: data = value[2].asString(); break;
+            case 4: data = static_cast<std::uint32_t>(value[2].asNumber<int64_t>()); break;
+            default: continue;
+            }
+            entry.meta.emplace(type, std::move(data));
+        }
+        lru_.push_back(key);
+        entry.lru = std::prev(lru_.end());
+        entries_.emplace(std::move(key), std::move(entry));
+    }
+
+    // thumbnails of entries lost in a crash
+    std::unordered_set<std::string> thumbnails;
+    for (const auto &entry : entries_)
+        thumbnails.insert(entry.second.thumbnail);
+    std::error_code err;
+    for (const auto &file : std::filesystem::directory_iterator(META_CACHE_DIRECTORY, err)) {
+        auto name = file.path().string();
+        if (name != path && thumbnails.find(name) == thumbnails.end())
+            std::filesystem::remove(file.path(), err);
+    }
+    LOG_INFO(MEDIA_INDEXER_CACHE, 0, "%zu entries in meta cache", entries_.size());
+}
+
+void MetaCache::evict()
+{
+    while (entries_.size() > capacity_ && !lru_.empty())
+        erase(entries_.find(lru_.back()));
+}
+
+void MetaCache::erase(std::unordered_map<std::string, Entry>::iterator iter)
+{
+    if (!iter->second.thumbnail.empty()) {
+        std::error_code err;
+        std::filesystem::remove(iter->second.thumbnail, err);
+    }
+    lru_.erase(iter->second.lru);
+    entries_.erase(iter);
+    changes_++;
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "mediaitem.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * \brief Extraction results keyed by file content.
+ *
+ * The database keys media items by uri which contains the device
+ * uuid and mount point, so the same file on a reformatted stick, in
+ * another card reader or copied to internal storage is extracted
+ * again. This cache keys the meta data by a fingerprint of the file
+ * content instead. It lives on internal storage, keeps its own copy
+ * of the thumbnails and drops the least recently used entries once
+ * it is full.
+ */
+class MetaCache
+{
+public:
+    static MetaCache *instance();
+    virtual ~MetaCache();
+
+    /**
+     * \brief Set the number of entries to keep.
+     *
+     * Loads the cache file on first use.
+     *
+     * \param[in] capacity Maximum number of entries, 0 disables the
+     * cache.
+     */
+    void setCapacity(size_t capacity);
+
+    /// The cache is in use.
+    bool enabled() const;
+
+    /**
+     * \brief Get the fingerprint of a local file.
+     *
+     * The fingerprint covers the file size and the first and last
+     * 64 KiB of the file.
+     *
+     * \param[in] path The file path.
+     * \return The fingerprint, empty if the file can not be read.
+     */
+    static std::string fingerprint(const std::string &path);
+
+    /**
+     * \brief Fill a media item from the cache.
+     *
+     * The thumbnail is copied to the thumbnail directory of the
+     * media item device. File specific meta data like the
+     * modification date is not restored.
+     *
+     * \param[in] key The file fingerprint.
+     * \param[in] mediaItem The media item to fill.
+     * \return True on a cache hit, else false.
+     */
+    bool restore(const std::string &key, MediaItem &mediaItem);
+
+    /**
+     * \brief Remember the meta data of an extracted media item.
+     *
+     * \param[in] key The file fingerprint.
+     * \param[in] mediaItem The extracted media item.
+     */
+    void store(const std::string &key, const MediaItem &mediaItem);
+
+    /**
+     * \brief Write the cache file if anything has changed.
+     *
+     * \return True on success, else false.
+     */
+    bool save();
+
+private:
+    /// Singleton
+    MetaCache();
+
+    struct Entry {
+        std::map<MediaItem::Meta, MediaItem::MetaData> meta;
+        /// Own copy of the thumbnail, empty if there is none.
+        std::string thumbnail;
+        std::list<std::string>::iterator lru;
+    };
+
+    /// Read the cache file, must be called with lock_ locked.
+    void load();
+
+    /// Drop entries beyond the capacity, must be called with lock_
+    /// locked.
+    void evict();
+
+    /// Drop an entry, must be called with lock_ locked.
+    void erase(std::unordered_map<std::string, Entry>::iterator iter);
+
+    /// Singleton instance object.
+    static std::unique_ptr<MetaCache> instance_;
+
+    std::unordered_map<std::string, Entry> entries_;
+    /// Keys, most recently used first.
+    std::list<std::string> lru_;
+    std::atomic<size_t> capacity_;
+    bool loaded_;
+    /// Entries changed since the last save.
+    size_t changes_;
+    std::mutex lock_;
+    /// Serializes writing the cache file.
+    std::mutex saveLock_;
+};
@@ -29,6 +29,22 @@ Configurator *Configurator::instance()
 Configurator::Configurator(std::string confPath)
     : confPath_(std::move(confPath))
     , force_sw_decoders_(false)
+    , fileTreeWalkThreads_(0)
+    , liveWatch_(false)
+    , skipUnchangedDirectories_(false)
+    , extractionLocalityWindow_(0)
+    , scanCheckpointInterval_(0)
+    , scanDebounceTime_(0)
+    , metaCacheSize_(0)
+    , extractionQueueSize_(0)
+    , persistQueueSize_(0)
+    , extractionThreads_(0)
+    , adaptiveExtractionThreads_(false)
+    , executorThreads_(0)
+    , scanThreads_(0)
+    , rotationalDiskExtractionWorkers_(0)
+    , interestTimeout_(0)
+    , statRowBatchSize_(0)
 {
     init();
 }
@@ -53,6 +69,167 @@ void Configurator::init()
     else
         force_sw_decoders_ = root["force-sw-decoders"].asBool();
 
+    // check file-tree-walk-threads field
+    if (root.hasKey("file-tree-walk-threads"))
+        fileTreeWalkThreads_ = root["file-tree-walk-threads"].asNumber<int32_t>();
+
+    // check live-watch field
+    if (root.hasKey("live-watch"))
+        liveWatch_ = root["live-watch"].asBool();
+
+    // check skip-unchanged-directories field
+    if (root.hasKey("skip-unchanged-directories"))
+        skipUnchangedDirectories_ = root["skip-unchanged-directories"].asBool();
+
+    // check extraction-locality-window field
+    if (root.hasKey("extraction-locality-window"))
+        extractionLocalityWindow_ = root["extraction-locality-window"].asNumber<int32_t>();
+
+    // check scan-checkpoint-interval field
+    if (root.hasKey("scan-checkpoint-interval"))
+        scanCheckpointInterval_ = root["scan-checkpoint-interval"].asNumber<int32_t>();
+
+    // check scan-debounce-ms field
+    if (root.hasKey("scan-debounce-ms"))
+        scanDebounceTime_ = root["scan-debounce-ms"].asNumber<int32_t>();
+
+    // check meta-cache-size field
+    if (root.hasKey("meta-cache-size"))
+        metaCacheSize_ = root["meta-cache-size"].asNumber<int32_t>();
+
+    // check extraction-queue-size field
+    if (root.hasKey("extraction-queue-size"))
+        extractionQueueSize_ = root["extraction-queue-size"].asNumber<int32_t>();
+
+    // check persist-queue-size field
+    if (root.hasKey("persist-queue-size"))
+        persistQueueSize_ = root["persist-queue-size"].asNumber<int32_t>();
+
+    // check extraction-threads field
+    if (root.hasKey("extraction-threads"))
+        extractionThreads_ = root["extraction-threads"].asNumber<int32_t>();
+
+    // check extraction-threads-adaptive field
+    if (root.hasKey("extraction-threads-adaptive"))
+        adaptiveExtractionThreads_ = root["extraction-threads-adaptive"].asBool();
+
+    // check executor-threads field
+    if (root.hasKey("executor-threads"))
+        executorThreads_ = root["executor-threads"].asNumber<int32_t>();
+
+    // check scan-threads field
+    if (root.hasKey("scan-threads"))
+        scanThreads_ = root["scan-threads"].asNumber<int32_t>();
+
+    // check rotational-disk-extraction-workers field
+    if (root.hasKey("rotational-disk-extraction-workers"))
+        rotationalDiskExtractionWorkers_ = root["rotational-disk-extraction-workers"].asNumber<int32_t>();
+
+    // check interest-ttl-ms field
+    if (root.hasKey("interest-ttl-ms"))
+        interestTimeout_ = root["interest-ttl-ms"].asNumber<int32_t>();
+
+    // check stat-row-batch-size field
+    if (root.hasKey("stat-row-batch-size"))
+        statRowBatchSize_ = root["stat-row-batch-size"].asNumber<int32_t>();
+
+    // check exclude field
+    if (root.hasKey("exclude")) {
+        auto exclude = root["exclude"];
+        if (exclude.hasKey("hidden"))
+            exclude_.hidden = exclude["hidden"].asBool();
+        if (exclude.hasKey("nomedia"))
+            exclude_.nomedia = exclude["nomedia"].asBool();
+        if (exclude.hasKey("max-depth"))
+            exclude_.maxDepth = exclude["max-depth"].asNumber<int32_t>();
+        if (exclude.hasKey("directories")) {
+            auto directories = exclude["directories"];
+            for (int idx = 0; idx < directories.arraySize(); idx++)
+                exclude_.directories.push_back(directories[idx].asString());
+        }
+        if (exclude.hasKey("patterns")) {
+            auto patterns = exclude["patterns"];
+            for (int idx = 0; idx < patterns.arraySize(); idx++)
+                exclude_.patterns.push_back(patterns[idx].asString());
+        }
+    }
+
+    // check governor field
+    if (root.hasKey("governor")) {
+        auto governor = root["governor"];
+        if (governor.hasKey("boot-delay-ms"))
+            governor_.bootDelay = governor["boot-delay-ms"].asNumber<int32_t>();
+        if (governor.hasKey("pressure-threshold"))
+            governor_.pressureThreshold = governor["pressure-threshold"].asNumber<double>();
+        if (governor.hasKey("poll-ms"))
+            governor_.pollInterval = governor["poll-ms"].asNumber<int32_t>();
+        if (governor.hasKey("throttled-walkers"))
+            governor_.throttledWalkers = governor["throttled-walkers"].asNumber<int32_t>();
+        if (governor.hasKey("throttled-extractors"))
+            governor_.throttledExtractors = governor["throttled-extractors"].asNumber<int32_t>();
+        if (governor.hasKey("playback-ttl-ms"))
+            governor_.playbackTimeout = governor["playback-ttl-ms"].asNumber<int32_t>();
+    }
+
+    // check extraction-lanes field
+    if (root.hasKey("extraction-lanes")) {
+        static const std::unordered_map<std::string, MediaItem::ExtractorType> extractors = {
+            { "taglib", MediaItem::ExtractorType::TagLibExtractor },
+            { "gstreamer", MediaItem::ExtractorType::GStreamerExtractor },
+            { "image", MediaItem::ExtractorType::ImageExtractor },
+            { "plugin", MediaItem::ExtractorType::EOL }
+        };
+        auto lanes = root["extraction-lanes"];
+        for (int idx = 0; idx < lanes.arraySize(); idx++) {
+            auto lane = lanes[idx];
+            auto name = lane["extractor"].asString();
+            auto extractor = extractors.find(name);
+            if (extractor == extractors.end()) {
+                LOG_WARNING(MEDIA_INDEXER_CONFIGURATOR, 0, "Unknown extraction lane '%s'", name.c_str());
+                continue;
+            }
+            ExtractionLaneConfig config;
+            config.extractor = extractor->second;
+            if (lane.hasKey("workers"))
+                config.workers = lane["workers"].asNumber<int32_t>();
+            extractionLanes_.push_back(config);
+        }
+    }
+
+    // check extraction-policy field
+    if (root.hasKey("extraction-policy")) {
+        static const std::unordered_map<std::string, MediaItem::Type> types = {
+            { "audio", MediaItem::Type::Audio },
+            { "video", MediaItem::Type::Video },
+            { "image", MediaItem::Type::Image },
+            { "any", MediaItem::Type::EOL }
+        };
+        auto rules = root["extraction-policy"];
+        for (int idx = 0; idx < rules.arraySize(); idx++) {
+            auto rule = rules[idx];
+            ExtractionRuleConfig config;
+            if (rule.hasKey("type")) {
+                auto name = rule["type"].asString();
+                auto type = types.find(name);
+                if (type == types.end()) {
+                    LOG_WARNING(MEDIA_INDEXER_CONFIGURATOR, 0, "Unknown extraction policy type '%s'",
+                        name.c_str());
+                    continue;
+                }
+                config.type = type->second;
+            }
+            if (rule.hasKey("device"))
+                config.device = rule["device"].asString();
+            if (rule.hasKey("min-size-mb"))
+                config.minSize = rule["min-size-mb"].asNumber<int32_t>();
+            if (rule.hasKey("meta"))
+                config.meta = rule["meta"].asString();
+            if (rule.hasKey("thumbnail"))
+                config.thumbnail = rule["thumbnail"].asString();
+            extractionPolicy_.push_back(config);
+        }
+    }
+
     // check supportedMediaExtension field
     if (!root.hasKey("supportedMediaExtension")) {
         LOG_WARNING(MEDIA_INDEXER_CONFIGURATOR, 0, "Can't find supportedMediaExtension field. need to check it!");
@@ -136,6 +313,106 @@ bool Configurator::getForceSWDecodersProperty() const
     return force_sw_decoders_;
 }
 
+int Configurator::getFileTreeWalkThreads() const
+{
+    return fileTreeWalkThreads_;
+}
+
+bool Configurator::getLiveWatch() const
+{
+    return liveWatch_;
+}
+
+bool Configurator::getSkipUnchangedDirectories() const
+{
+    return skipUnchangedDirectories_;
+}
+
+int Configurator::getExtractionLocalityWindow() const
+{
+    return extractionLocalityWindow_;
+}
+
+int Configurator::getScanCheckpointInterval() const
+{
+    return scanCheckpointInterval_;
+}
+
+int Configurator::getScanDebounceTime() const
+{
+    return scanDebounceTime_;
+}
+
+int Configurator::getMetaCacheSize() const
+{
+    return metaCacheSize_;
+}
+
+int Configurator::getExtractionQueueSize() const
+{
+    return extractionQueueSize_;
+}
+
+int Configurator::getPersistQueueSize() const
+{
+    return persistQueueSize_;
+}
+
+int Configurator::getExtractionThreads() const
+{
+    return extractionThreads_;
+}
+
+bool Configurator::getAdaptiveExtractionThreads() const
+{
+    return adaptiveExtractionThreads_;
+}
+
+int Configurator::getExecutorThreads() const
+{
+    return executorThreads_;
+}
+
+int Configurator::getScanThreads() const
+{
+    return scanThreads_;
+}
+
+int Configurator::getRotationalDiskExtractionWorkers() const
+{
+    return rotationalDiskExtractionWorkers_;
+}
+
+int Configurator::getInterestTimeout() const
+{
+    return interestTimeout_;
+}
+
+int Configurator::getStatRowBatchSize() const
+{
+    return statRowBatchSize_;
+}
+
+const ExcludeConfig &Configurator::getExcludeConfig() const
+{
+    return exclude_;
+}
+
+const GovernorConfig &Configurator::getGovernorConfig() const
+{
+    return governor_;
+}
+
+const std::vector<ExtractionLaneConfig> &Configurator::getExtractionLanes() const
+{
+    return extractionLanes_;
+}
+
+const std::vector<ExtractionRuleConfig> &Configurator::getExtractionPolicy() const
+{
+    return extractionPolicy_;
+}
+
 std::string Configurator::getConfigurationPath() const
 {
     return confPath_;
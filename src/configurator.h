@@ -19,11 +19,66 @@
 #include "mediaitem.h"
 #include <pbnjson.hpp>
 #include <unordered_map>
+#include <vector>
 
 /// alias
 using MediaItemTypeInfo = std::pair<MediaItem::Type, MediaItem::ExtractorType>;
 using ExtensionMap = std::unordered_map<std::string, MediaItemTypeInfo>;
 
+/// Directories to leave out of the file tree walk.
+struct ExcludeConfig {
+    /// skip hidden files and directories
+    bool hidden = true;
+    /// skip directories containing a .nomedia file
+    bool nomedia = false;
+    /// maximum directory depth below the mountpoint, 0 is unlimited
+    int maxDepth = 0;
+    /// directory names, case insensitive
+    std::vector<std::string> directories;
+    /// glob patterns for directory paths relative to the mountpoint
+    std::vector<std::string> patterns;
+};
+
+/// Indexing governor, see Governor.
+struct GovernorConfig {
+    /// system uptime in milliseconds before indexing starts
+    int bootDelay = 0;
+    /// cpu or io pressure in percent above which indexing is
+    /// throttled, 0 ignores the pressure
+    double pressureThreshold = 0;
+    /// milliseconds between pressure samples
+    int pollInterval = 1000;
+    /// parallel directory reads while throttled, 0 pauses the walk
+    int throttledWalkers = 1;
+    /// parallel extractions while throttled, 0 pauses the extraction
+    int throttledExtractors = 1;
+    /// milliseconds a playback is taken as active unless renewed, 0
+    /// keeps it until it is stopped
+    int playbackTimeout = 300000;
+};
+
+/// Meta data extraction lane.
+struct ExtractionLaneConfig {
+    /// extractor type, EOL for media items extracted by their plugin
+    MediaItem::ExtractorType extractor = MediaItem::ExtractorType::EOL;
+    /// maximum number of concurrent extractions, 0 is unlimited
+    int workers = 0;
+};
+
+/// Extraction policy rule, see ExtractionPolicy.
+struct ExtractionRuleConfig {
+    /// media type, EOL matches any
+    MediaItem::Type type = MediaItem::Type::EOL;
+    /// device class as the device uri scheme, empty matches any
+    std::string device;
+    /// smallest matching file size in MiB
+    int minSize = 0;
+    /// meta data handling, one of "now", "defer" and "skip"
+    std::string meta = "now";
+    /// thumbnail handling, one of "now", "defer" and "skip"
+    std::string thumbnail = "now";
+};
+
 /// Configurator class for media indexer configuration from json conf file.
 class Configurator
 {
@@ -37,6 +92,26 @@ public:
     MediaItemTypeInfo getTypeInfo(const std::string& ext) const;
     ExtensionMap getSupportedExtensions() const;
     bool getForceSWDecodersProperty() const;
+    int getFileTreeWalkThreads() const;
+    bool getLiveWatch() const;
+    bool getSkipUnchangedDirectories() const;
+    int getExtractionLocalityWindow() const;
+    int getScanCheckpointInterval() const;
+    int getScanDebounceTime() const;
+    int getMetaCacheSize() const;
+    int getExtractionQueueSize() const;
+    int getPersistQueueSize() const;
+    int getExtractionThreads() const;
+    bool getAdaptiveExtractionThreads() const;
+    int getExecutorThreads() const;
+    int getScanThreads() const;
+    int getRotationalDiskExtractionWorkers() const;
+    int getInterestTimeout() const;
+    int getStatRowBatchSize() const;
+    const ExcludeConfig &getExcludeConfig() const;
+    const GovernorConfig &getGovernorConfig() const;
+    const std::vector<ExtractionLaneConfig> &getExtractionLanes() const;
+    const std::vector<ExtractionRuleConfig> &getExtractionPolicy() const;
     std::string getConfigurationPath() const;
     bool insertExtension(const std::string& ext,
                          const MediaItem::Type& type = MediaItem::Type::EOL,
@@ -58,6 +133,78 @@ public:
     /// GStreamer property for software decoding
     bool force_sw_decoders_;
 
+    /// number of file tree walker threads, 0 means default
+    int fileTreeWalkThreads_;
+
+    /// watch scanned devices for changes
+    bool liveWatch_;
+
+    /// take over files of unchanged directories from the cache on rescan
+    bool skipUnchangedDirectories_;
+
+    /// number of queued items to pick the next extraction from by disk
+    /// position, 0 keeps the walk order
+    int extractionLocalityWindow_;
+
+    /// seconds between scan progress checkpoints, 0 disables them
+    int scanCheckpointInterval_;
+
+    /// milliseconds to wait for further scan requests of a device
+    /// before scanning it, 0 scans right away
+    int scanDebounceTime_;
+
+    /// number of extraction results kept by file content, 0 disables
+    /// the meta cache
+    int metaCacheSize_;
+
+    /// number of media items waiting for or in meta data extraction
+    /// before the walk blocks, 0 is unbounded
+    int extractionQueueSize_;
+
+    /// number of media items sent to the database without reply
+    /// before extraction blocks, 0 is unbounded
+    int persistQueueSize_;
+
+    /// number of meta data extraction threads, 0 means the build
+    /// default; the upper limit in adaptive mode
+    int extractionThreads_;
+
+    /// size the extraction thread pool by cpu load, iowait and item
+    /// latency at runtime
+    bool adaptiveExtractionThreads_;
+
+    /// maximum number of shared threads for device scans, cleanups
+    /// and discovery, 0 means default
+    int executorThreads_;
+
+    /// maximum number of threads for device scans and cleanups, 0
+    /// means default
+    int scanThreads_;
+
+    /// number of parallel meta data extractions per rotational disk,
+    /// 0 is unlimited
+    int rotationalDiskExtractionWorkers_;
+
+    /// milliseconds a queried uri prefix is extracted first, 0
+    /// disables the interest boost
+    int interestTimeout_;
+
+    /// stat-only rows of a new device put in one request ahead of
+    /// the meta data, 0 disables the early rows
+    int statRowBatchSize_;
+
+    /// excluded directories
+    ExcludeConfig exclude_;
+
+    /// indexing governor
+    GovernorConfig governor_;
+
+    /// extraction lanes, most urgent first
+    std::vector<ExtractionLaneConfig> extractionLanes_;
+
+    /// extraction policy rules, the first matching one applies
+    std::vector<ExtractionRuleConfig> extractionPolicy_;
+
     /// Singleton instance object.
     static std::unique_ptr<Configurator> instance_;
 };
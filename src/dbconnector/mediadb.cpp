@@ -23,11 +23,17 @@
 #include "mediaindexer.h"
 #include "mediaparser.h"
 #include "performancechecker.h"
+#include "cache/durablefile.h"
+#include "configurator.h"
+#include "pipelinestage.h"
 
 #include <cstdio>
 #include <gio/gio.h>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
 #include <unistd.h>
 std::unique_ptr<MediaDb> MediaDb::instance_;
 
@@ -35,6 +41,8 @@ typedef struct RespData
 {
     Device *dev;
     size_t cnt;
+    /// Scan generation of dev at request time.
+    unsigned long gen;
 } RespData;
 
 MediaDb *MediaDb::instance()
@@ -120,9 +128,12 @@ bool MediaDb::handleLunaResponse(LSMessage *msg)
     } else if (method == std::string("mergePut")) {
         LOG_DEBUG(MEDIA_INDEXER_MEDIADB, "method : %s", method.c_str());
         if (sd.object) {
+            // entered in updateMediaItem()
+            PipelineStage::Scope persist(PipelineStage::Id::Persist, std::adopt_lock);
             MediaItemPtr mi(static_cast<MediaItem *>(sd.object));
             DevicePtr device = mi->device();
-            if (device) {
+            // counted against a scan which is no longer running
+            if (device && !mi->cancelled()) {
                 device->incrementProcessedItemCount(mi->type());
                 if (device->processingDone()) {
                     LOG_DEBUG(MEDIA_INDEXER_MEDIADB, "Activate cleanup task");
@@ -140,7 +151,7 @@ bool MediaDb::handleLunaResponse(LSMessage *msg)
         RespData *resp = static_cast<RespData *>(sd.object);
         if (resp) {
             Device *device = resp->dev;
-            if (device) {
+            if (device && !device->scanCancelled(resp->gen)) {
                 device->incrementTotalProcessedItemCount(resp->cnt);
                 if (device->processingDone()) {
                     LOG_DEBUG(MEDIA_INDEXER_MEDIADB, "Activate cleanup task");
@@ -178,7 +189,7 @@ bool MediaDb::handleLunaResponse(LSMessage *msg)
         RespData *resp = static_cast<RespData *>(sd.object);
         if (resp) {
             Device *device = resp->dev;
-            if (device) {
+            if (device && !device->scanCancelled(resp->gen)) {
                 device->incrementTotalRemovedItemCount(resp->cnt);
                 if (device->processingDone()) {
                     LOG_DEBUG(MEDIA_INDEXER_MEDIADB, "Activate cleanup task");
@@ -376,6 +387,9 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
     }
     case MediaDbMethod::RemoveDirty: {
         if (results.isArray() && results.isValid() && !results.isNull()) {
+            // thumbnails are removed in one go, every thumbnail
+            // directory is synced once
+            UnlinkBatch thumbnails;
             for (auto item : results.items()) {
                 auto uri = item["uri"].asString();
                 auto thumbnail = item["thumbnail"].asString();
@@ -395,17 +409,12 @@ bool MediaDb::handleLunaResponseMetaData(LSMessage *msg)
 
                 }
 
-                if (!thumbnail.empty()) {
-                    int remove_ret = std::remove(thumbnail.c_str());
-
-                    if (remove_ret != 0)
-                        LOG_ERROR(MEDIA_INDEXER_MEDIADB, 0, "Error deleting thumbnail file : [%s]",
-                                thumbnail.c_str());
-
-                    sync();
-                }
+                if (!thumbnail.empty())
+                    thumbnails.add(thumbnail);
 
             }
+            if (thumbnails.commit() > 0)
+                LOG_ERROR(MEDIA_INDEXER_MEDIADB, 0, "Error deleting thumbnail files");
         }
         ret = true;
         break;
@@ -506,30 +515,60 @@ void MediaDb::updateMediaItem(MediaItemPtr mediaItem)
 
     std::string kind_type = kindMap_[mediaItem->type()];
 
-    for (auto meta = MediaItem::Meta::Title; meta < MediaItem::Meta::Track; ++meta) {
-        auto metaStr = mediaItem->metaToString(meta);
-        auto data = mediaItem->meta(meta);
-
-        //Todo - Only media kind columns should be stored.
-        //if(mediaItem->isMediaMeta(meta))
-        //mediaItem->putProperties(metaStr, data, props);
-
-        if ((mediaItem->type() == MediaItem::Type::Audio && mediaItem->isAudioMeta(meta))
-            ||(mediaItem->type() == MediaItem::Type::Video && mediaItem->isVideoMeta(meta))
-            ||(mediaItem->type() == MediaItem::Type::Image && mediaItem->isImageMeta(meta))) {
-            mediaItem->putProperties(std::move(metaStr), std::move(data), props);
-        }
-    }
+    putMediaMeta(*mediaItem, props);
+    if (mediaItem->deferred())
+        props.put(DEFERRED, true);
     //mergePut(mediaItem->uri(), true, props, nullptr, MEDIA_KIND);
     auto dev = mediaItem->device();
     if (dev->isNewMountedDevice()) {
-        props.put("_kind", kind_type);
-        putMeta(props, std::move(dev));
+        // buffered and flushed in batches of FLUSH_COUNT
+        PipelineStage::Scope persist(PipelineStage::Id::Persist);
+        putMeta(props, kind_type, std::move(dev));
     } else {
+        // the media item lives until the reply, this blocks the
+        // extraction while too many requests are in flight
+        PipelineStage::get(PipelineStage::Id::Persist).enter();
         const auto &uri = mediaItem->uri();
         // release ownership for this mediaItem.
         auto mi = mediaItem.release();
-        mergePut(uri, true, props, mi, kind_type);
+        if (!mergePut(uri, true, props, mi, kind_type)) {
+            delete mi;
+            PipelineStage::get(PipelineStage::Id::Persist).leave();
+        }
+    }
+}
+
+void MediaDb::completeDeferred(MediaItem &mediaItem)
+{
+    if (mediaItem.type() == MediaItem::Type::EOL) {
+        LOG_ERROR(MEDIA_INDEXER_MEDIADB, 0, "Invalid media type");
+        return;
+    }
+
+    auto props = pbnjson::Object();
+    putMediaMeta(mediaItem, props);
+    props.put(DEFERRED, false);
+    // not counted, the scan has accounted for the media item already
+    if (!merge(kindMap_[mediaItem.type()], props, URI, mediaItem.uri(), true))
+        LOG_ERROR(MEDIA_INDEXER_MEDIADB, 0, "Failed to store deferred meta data of '%s'",
+            mediaItem.uri().c_str());
+}
+
+void MediaDb::putMediaMeta(MediaItem &mediaItem, pbnjson::JValue &props) const
+{
+    for (auto meta = MediaItem::Meta::Title; meta < MediaItem::Meta::Track; ++meta) {
+        auto metaStr = mediaItem.metaToString(meta);
+        auto data = mediaItem.meta(meta);
+
+        //Todo - Only media kind columns should be stored.
+        //if(mediaItem->isMediaMeta(meta))
+        //mediaItem->putProperties(metaStr, data, props);
+
+        if ((mediaItem.type() == MediaItem::Type::Audio && mediaItem.isAudioMeta(meta))
+            ||(mediaItem.type() == MediaItem::Type::Video && mediaItem.isVideoMeta(meta))
+            ||(mediaItem.type() == MediaItem::Type::Image && mediaItem.isImageMeta(meta))) {
+            mediaItem.putProperties(std::move(metaStr), std::move(data), props);
+        }
     }
 }
 
@@ -544,14 +583,31 @@ std::optional<std::string> MediaDb::getFilePath(
     return plg->getPlaybackUri(uri);
 }
 
-bool MediaDb::putMeta(pbnjson::JValue &params, DevicePtr device)
+bool MediaDb::putMeta(pbnjson::JValue &params, const std::string &kind, DevicePtr device)
 {
     const auto &uri = device->uri();
     std::unique_lock<std::mutex> lk(mutex_);
+    dropStaleTempBuf(device.get());
     if (firstScanTempBuf_.find(uri) == firstScanTempBuf_.end()) {
         firstScanTempBuf_.emplace(uri, pbnjson::Array());
     }
-    firstScanTempBuf_[uri] << params;
+    if (statRowBatchSize_ > 0) {
+        // the row has been put by putStatRow() already
+        auto query = pbnjson::Object();
+        query.put("from", kind);
+
+        auto wheres = pbnjson::Array();
+        prepareWhere(URI, params[URI].asString(), true, wheres);
+        query.put("where", wheres);
+
+        auto param = pbnjson::Object();
+        param.put("query", query);
+        param.put("props", params);
+        prepareOperation("merge", param, firstScanTempBuf_[uri]);
+    } else {
+        params.put("_kind", kind);
+        firstScanTempBuf_[uri] << params;
+    }
     device->incrementPutItemCount();
     //LOG_PERF("array size : %d", firstScanTempBuf_[uri].arraySize());
     if(firstScanTempBuf_[uri].arraySize() >= FLUSH_COUNT || device->needFlushed())
@@ -562,11 +618,20 @@ bool MediaDb::putMeta(pbnjson::JValue &params, DevicePtr device)
 bool MediaDb::flushPut(Device* device)
 {
     if (device) {
+        if (dropStaleTempBuf(device))
+            return true;
         const auto &uri = device->uri();
         if (firstScanTempBuf_.find(uri) != firstScanTempBuf_.end()) {
             if (firstScanTempBuf_[uri].arraySize() > 0) {
-                RespData *obj = new RespData {device, static_cast<size_t>(firstScanTempBuf_[uri].arraySize())};
-                put(firstScanTempBuf_[uri], (void *)obj);
+                RespData *obj = new RespData {device, static_cast<size_t>(firstScanTempBuf_[uri].arraySize()),
+                    device->scanGeneration()};
+                if (statRowBatchSize_ > 0) {
+                    // the merges must not overtake the rows they go to
+                    sendStatRows(device);
+                    batch(firstScanTempBuf_[uri], "put", (void *)obj);
+                } else {
+                    put(firstScanTempBuf_[uri], (void *)obj);
+                }
                 while (firstScanTempBuf_[uri].arraySize() > 0)
                     firstScanTempBuf_[uri].remove(ssize_t(0));
             }
@@ -578,6 +643,68 @@ bool MediaDb::flushPut(Device* device)
     return true;
 }
 
+void MediaDb::putStatRow(const MediaItem &mediaItem)
+{
+    if (statRowBatchSize_ == 0 || mediaItem.type() == MediaItem::Type::EOL)
+        return;
+
+    auto props = pbnjson::Object();
+    props.put("_kind", kindMap_[mediaItem.type()]);
+    props.put(URI, mediaItem.uri());
+    props.put(DIRTY, false);
+    auto filepath = getFilePath(mediaItem.uri());
+    props.put(FILE_PATH, filepath ? filepath.value() : "");
+    props.put(MediaItem::metaToString(MediaItem::Meta::Title), mediaItem.fileTitle());
+    props.put(MediaItem::metaToString(MediaItem::Meta::FileSize),
+        static_cast<std::int64_t>(mediaItem.fileSize()));
+    // same format as the meta data extractors use
+    std::time_t mtime = mediaItem.modifiedTime();
+    struct tm tm;
+    // the walker workers get here in parallel, no shared buffer
+    if (mtime && gmtime_r(&mtime, &tm)) {
+        std::stringstream ss;
+        ss << std::put_time(&tm, "%c %Z");
+        props.put(MediaItem::metaToString(MediaItem::Meta::LastModifiedDate), ss.str());
+    }
+
+    auto device = mediaItem.device();
+    const auto &uri = device->uri();
+    std::unique_lock<std::mutex> lk(mutex_);
+    dropStaleTempBuf(device.get());
+    if (statRowTempBuf_.find(uri) == statRowTempBuf_.end()) {
+        statRowTempBuf_.emplace(uri, pbnjson::Array());
+    }
+    statRowTempBuf_[uri] << props;
+    if (static_cast<size_t>(statRowTempBuf_[uri].arraySize()) >= statRowBatchSize_)
+        sendStatRows(device.get());
+}
+
+void MediaDb::flushStatRows(Device *device)
+{
+    std::unique_lock<std::mutex> lk(mutex_);
+    if (device) {
+        sendStatRows(device);
+    } else {
+        LOG_ERROR(MEDIA_INDEXER_MEDIADB, 0, "Invalid input device");
+    }
+}
+
+void MediaDb::sendStatRows(Device *device)
+{
+    if (dropStaleTempBuf(device))
+        return;
+    auto iter = statRowTempBuf_.find(device->uri());
+    if (iter == statRowTempBuf_.end() || iter->second.arraySize() == 0)
+        return;
+
+    LOG_DEBUG(MEDIA_INDEXER_MEDIADB, "Put %zd stat-only rows for '%s'",
+        static_cast<ssize_t>(iter->second.arraySize()), device->uri().c_str());
+    // not counted, a media item is processed once its meta data is in
+    put(iter->second, nullptr, false, "putStatRows");
+    while (iter->second.arraySize() > 0)
+        iter->second.remove(ssize_t(0));
+}
+
 void MediaDb::markDirty(std::shared_ptr<Device> device, MediaItem::Type type)
 {
     // update or create the device in the database
@@ -633,25 +760,79 @@ void MediaDb::unflagDirty(MediaItemPtr mediaItem)
 
     auto device = mediaItem->device();
     const auto &duri = device->uri();
-    if (reScanTempBuf_.find(duri) == reScanTempBuf_.end()) {
-        reScanTempBuf_.emplace(duri, pbnjson::Array());
+    bool flush = false;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        dropStaleTempBuf(device.get());
+        if (reScanTempBuf_.find(duri) == reScanTempBuf_.end()) {
+            reScanTempBuf_.emplace(duri, pbnjson::Array());
+        }
+        prepareOperation("merge", param, reScanTempBuf_[duri]);
+        device->incrementDirtyItemCount();
+        flush = reScanTempBuf_[duri].arraySize() >= FLUSH_COUNT;
     }
-    prepareOperation("merge", param, reScanTempBuf_[duri]);
-    device->incrementDirtyItemCount();
-    if (reScanTempBuf_[duri].arraySize() >= FLUSH_COUNT) {
+    if (flush)
         flushUnflagDirty(device.get());
+}
+
+void MediaDb::renameMediaItem(MediaItemPtr mediaItem, const std::string &oldUri)
+{
+    const auto &uri = mediaItem->uri();
+    MediaItem::Type type = mediaItem->type();
+    if (type == MediaItem::Type::EOL) {
+        LOG_ERROR(MEDIA_INDEXER_MEDIADB, 0, "ERROR : Media Item type for uri %s should not be EOL", uri.c_str());
+        return;
     }
+
+    auto query = pbnjson::Object();
+    query.put("from", kindMap_[type]);
+
+    auto wheres = pbnjson::Array();
+    prepareWhere(URI, oldUri, true, wheres);
+    query.put("where", wheres);
+
+    auto props = pbnjson::Object();
+    props.put(URI, uri);
+    props.put(HASH, std::to_string(mediaItem->hash()));
+    props.put(DIRTY, false);
+    auto filepath = getFilePath(uri);
+    props.put(FILE_PATH, filepath ? filepath.value() : "");
+
+    auto param = pbnjson::Object();
+    param.put("query", query);
+    param.put("props", props);
+
+    // goes along with the unflag dirty requests, both only touch
+    // existing entries, the walker workers append concurrently
+    auto device = mediaItem->device();
+    const auto &duri = device->uri();
+    bool flush = false;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        dropStaleTempBuf(device.get());
+        if (reScanTempBuf_.find(duri) == reScanTempBuf_.end()) {
+            reScanTempBuf_.emplace(duri, pbnjson::Array());
+        }
+        prepareOperation("merge", param, reScanTempBuf_[duri]);
+        device->incrementDirtyItemCount();
+        flush = reScanTempBuf_[duri].arraySize() >= FLUSH_COUNT;
+    }
+    if (flush)
+        flushUnflagDirty(device.get());
 }
 
 void MediaDb::flushUnflagDirty(Device *device)
 {
     std::unique_lock<std::mutex> lk(mutex_);
     if (device) {
+        if (dropStaleTempBuf(device))
+            return;
         const auto &uri = device->uri();
         if (reScanTempBuf_.find(uri) != reScanTempBuf_.end()) {
             if (reScanTempBuf_[uri].arraySize() > 0) {
 
-                RespData *obj = new RespData {device, static_cast<size_t>(reScanTempBuf_[uri].arraySize())};
+                RespData *obj = new RespData {device, static_cast<size_t>(reScanTempBuf_[uri].arraySize()),
+                    device->scanGeneration()};
                 batch(reScanTempBuf_[uri], "unflagDirty", (void *)obj);
 
                 while (reScanTempBuf_[uri].arraySize() > 0)
@@ -684,14 +865,19 @@ void MediaDb::requestDeleteItem(MediaItemPtr mediaItem)
 
     auto device = mediaItem->device();
     const auto &duri = device->uri();
-    if (reScanTempBuf_.find(duri) == reScanTempBuf_.end()) {
-        reScanTempBuf_.emplace(duri, pbnjson::Array());
+    bool flush = false;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        dropStaleTempBuf(device.get());
+        if (reScanTempBuf_.find(duri) == reScanTempBuf_.end()) {
+            reScanTempBuf_.emplace(duri, pbnjson::Array());
+        }
+        prepareOperation("del", param, reScanTempBuf_[duri]);
+        device->incrementRemoveItemCount();
+        flush = reScanTempBuf_[duri].arraySize() >= FLUSH_COUNT;
     }
-    prepareOperation("del", param, reScanTempBuf_[duri]);
-    device->incrementRemoveItemCount();
-    if(reScanTempBuf_[duri].arraySize() >= FLUSH_COUNT) {
+    if (flush)
         flushDeleteItems(device.get());
-    }
 }
 
 void MediaDb::flushDeleteItems(Device *device)
@@ -701,6 +887,8 @@ void MediaDb::flushDeleteItems(Device *device)
         LOG_ERROR(MEDIA_INDEXER_MEDIADB, 0, "Invalid input device");
         return;
     }
+    if (dropStaleTempBuf(device))
+        return;
 
     const auto &uri = device->uri();
     auto iter = reScanTempBuf_.find(uri);
@@ -708,7 +896,7 @@ void MediaDb::flushDeleteItems(Device *device)
         auto array = iter->second;
         auto arraySize = iter->second.arraySize();
         if (arraySize > 0) {
-            RespData *obj = new RespData {device, static_cast<size_t>(arraySize)};
+            RespData *obj = new RespData {device, static_cast<size_t>(arraySize), device->scanGeneration()};
             batch(array, "flushDeleteItems", static_cast<void*>(obj));
 
             while (arraySize > 0) {
@@ -720,6 +908,32 @@ void MediaDb::flushDeleteItems(Device *device)
 }
 
 
+bool MediaDb::dropStaleTempBuf(Device *device)
+{
+    const auto &uri = device->uri();
+    auto generation = device->scanGeneration();
+    auto iter = tempBufGen_.find(uri);
+    if (iter == tempBufGen_.end()) {
+        tempBufGen_.emplace(uri, generation);
+        return false;
+    }
+    if (!device->scanCancelled(iter->second))
+        return false;
+
+    // the device has gone or is being scanned again, the replies
+    // would not be counted anyway
+    LOG_DEBUG(MEDIA_INDEXER_MEDIADB, "Drop buffered requests of an earlier scan of '%s'", uri.c_str());
+    for (auto buf : { &firstScanTempBuf_, &statRowTempBuf_, &reScanTempBuf_ }) {
+        auto entry = buf->find(uri);
+        if (entry == buf->end())
+            continue;
+        while (entry->second.arraySize() > 0)
+            entry->second.remove(ssize_t(0));
+    }
+    iter->second = generation;
+    return true;
+}
+
 bool MediaDb::resetFirstScanTempBuf(const std::string &uri)
 {
     if (uri.empty()) {
@@ -727,10 +941,15 @@ bool MediaDb::resetFirstScanTempBuf(const std::string &uri)
         return false;
     }
 
+    std::lock_guard<std::mutex> lk(mutex_);
     if (firstScanTempBuf_.find(uri) != firstScanTempBuf_.end()) {
         while (firstScanTempBuf_[uri].arraySize() > 0)
             firstScanTempBuf_[uri].remove(ssize_t(0));
     }
+    if (statRowTempBuf_.find(uri) != statRowTempBuf_.end()) {
+        while (statRowTempBuf_[uri].arraySize() > 0)
+            statRowTempBuf_[uri].remove(ssize_t(0));
+    }
 
     return true;
 }
@@ -742,6 +961,7 @@ bool MediaDb::resetReScanTempBuf(const std::string &uri)
         return false;
     }
 
+    std::lock_guard<std::mutex> lk(mutex_);
     if (reScanTempBuf_.find(uri) != reScanTempBuf_.end()) {
         while (reScanTempBuf_[uri].arraySize() > 0)
             reScanTempBuf_[uri].remove(ssize_t(0));
@@ -1013,4 +1233,12 @@ MediaDb::MediaDb() :
         index.put("props", props);
         kindIndexes_ << index;
     }
+
+    auto queueSize = Configurator::instance()->getPersistQueueSize();
+    if (queueSize > 0)
+        PipelineStage::get(PipelineStage::Id::Persist).setCapacity(static_cast<size_t>(queueSize));
+
+    auto statRows = Configurator::instance()->getStatRowBatchSize();
+    if (statRows > 0)
+        statRowBatchSize_ = static_cast<size_t>(statRows);
 }
@@ -116,6 +116,17 @@ public:
      */
     void unflagDirty(MediaItemPtr mediaItem);
 
+    /**
+     * \brief Move the database entry of a media item to its new uri.
+     *
+     * The meta data and the thumbnail are kept, only the location is
+     * updated.
+     *
+     * \param[in] mediaItem The media item at its new location.
+     * \param[in] oldUri Uri of the existing database entry.
+     */
+    void renameMediaItem(MediaItemPtr mediaItem, const std::string &oldUri);
+
     void unmarkAllDirty(std::shared_ptr<Device> device, MediaItem::Type type = MediaItem::Type::EOL);
 
     /**
@@ -176,10 +187,37 @@ public:
      *        If more than a certain number is accumulated,
      *        it is flushed.
      * \param[in] params Meta data formatted with json format.
+     * \param[in] kind The kind of the media item.
      * \param[in] device The device contains the media item.
      * \return true if the operation is sucessful.
      */
-    bool putMeta(pbnjson::JValue &params, DevicePtr device);
+    bool putMeta(pbnjson::JValue &params, const std::string &kind, DevicePtr device);
+
+    /**
+     * \brief Store the meta data extracted after the first request for
+     * a media item whose extraction has been deferred by the scan.
+     *
+     * \param[in] mediaItem The media item, fully extracted.
+     */
+    void completeDeferred(MediaItem &mediaItem);
+
+    /**
+     * \brief put a row with what the file tree walk knows to buffer.
+     *
+     * The row of a media item on a new device shows up before its
+     * meta data has been extracted, the meta data is merged into it
+     * later on. The row has no hash so it is taken as incomplete
+     * until then.
+     *
+     * \param[in] mediaItem The media item, not yet parsed.
+     */
+    void putStatRow(const MediaItem &mediaItem);
+
+    /**
+     * \brief flush stat-only rows from buffer to db8 service.
+     * \param[in] device The device the rows belong to.
+     */
+    void flushStatRows(Device *device);
 
     /**
      * \brief flush meta data from buffer to db8 service.
@@ -229,6 +267,18 @@ private:
                           pbnjson::JValue &param,
                           pbnjson::JValue &operationClause) const;
 
+    /// Put the meta data of the media item type to props.
+    void putMediaMeta(MediaItem &mediaItem, pbnjson::JValue &props) const;
+
+    /// Send the buffered stat-only rows, must be called with mutex_
+    /// locked.
+    void sendStatRows(Device *device);
+
+    /// Drop the buffered requests of a device if they have been made
+    /// by an earlier scan, must be called with mutex_ locked.
+    /// \return true if requests have been dropped.
+    bool dropStaleTempBuf(Device *device);
+
 
 
     /// Singleton object.
@@ -267,7 +317,13 @@ private:
     static constexpr char TYPE[] = "type";
     static constexpr char MIME[] = "mime";
     static constexpr char FILE_PATH[] = "file_path";
+    static constexpr char DEFERRED[] = "deferred";
 
     std::map<std::string, pbnjson::JValue> firstScanTempBuf_;
+    std::map<std::string, pbnjson::JValue> statRowTempBuf_;
+    /// Rows per stat-only put, 0 if new devices are put in one go.
+    size_t statRowBatchSize_ = 0;
     std::map<std::string, pbnjson::JValue> reScanTempBuf_;
+    /// Scan generation of the buffered requests per device.
+    std::map<std::string, unsigned long> tempBufGen_;
 };
@@ -18,8 +18,36 @@
 #include "plugins/pluginfactory.h"
 #include "plugins/plugin.h"
 #include "dbconnector/mediadb.h"
+#include "cachemanager.h"
+#include "configurator.h"
+#include "diskscheduler.h"
 #include <filesystem>
 
+/// Upper limit for the scan debounce as multiple of the debounce time,
+/// a device which keeps flapping is scanned anyway.
+#define DEVICE_SCAN_DEBOUNCE_MAX 10
+
+namespace {
+
+/// Deepest directory containing both paths.
+std::string commonDirectory(const std::string &a, const std::string &b)
+{
+    if (a == b)
+        return a;
+    size_t idx = 0;
+    size_t len = 0;
+    for (; idx < a.size() && idx < b.size() && a[idx] == b[idx]; ++idx) {
+        if (a[idx] == '/')
+            len = idx;
+    }
+    // one path is a directory below the other
+    if ((idx == a.size() && b[idx] == '/') || (idx == b.size() && a[idx] == '/'))
+        len = idx;
+    return a.substr(0, len);
+}
+
+} // namespace
+
 // Not part of Device class, this is defined at the bottom of device.h
 Device::Meta &operator++(Device::Meta &meta)
 {
@@ -83,7 +111,8 @@ Device::Device(const std::string &uri, int alive, bool avail, std::string uuid)
     available_(avail),
     alive_(alive),
     maxAlive_(alive),
-    observer_(nullptr)
+    observer_(nullptr),
+    strand_(Executor::scanInstance())
 {
     lastSeen_ = std::chrono::system_clock::now();
     LOG_DEBUG(MEDIA_INDEXER_DEVICE, "Device Ctor, URI : %s UUID : %s, object : %p", uri_.c_str(), uuid_.c_str(), this);
@@ -91,16 +120,10 @@ Device::Device(const std::string &uri, int alive, bool avail, std::string uuid)
 
 Device::~Device()
 {
-    // nothing to be done here, the only allocated object is the
-    // scanner thread which runs in detached mode and thus does not
-    // need any cleanup
+    // the strand jobs keep the device alive while they run, so at
+    // most queued jobs are left to be dropped
     LOG_DEBUG(MEDIA_INDEXER_DEVICE, "Device Dtor, URI : %s UUID : %s OBJECT : %p", uri_.c_str(), uuid_.c_str(), this);
-    exit_ = true;
-    queue_.push_back("");
-    cv_.notify_one();
-    if (task_.joinable())
-        task_.join();
-    cleanUpTask_.destroy();
+    strand_.close();
 }
 
 void Device::init()
@@ -108,20 +131,6 @@ void Device::init()
     if (!createThumbnailDirectory()) {
         LOG_ERROR(MEDIA_INDEXER_DEVICE, 0, "Failed to create corresponding thumbnail directory for device UUID %s", uuid_.c_str());
     }
-    task_ = std::thread(&Device::scanLoop, this);
-    task_.detach();
-
-    auto cleanTaskFunc = [] (void *ctx, void *data) -> void {
-        Device* dev = static_cast<Device *>(ctx);
-        if (dev) {
-            LOG_DEBUG(MEDIA_INDEXER_DEVICE, "Clean Up Task start for device '%s'", dev->uri().c_str());
-            auto obs = dev->observer();
-            if (obs)
-                obs->cleanupDevice(dev);
-        }
-    };
-
-    cleanUpTask_.create(cleanTaskFunc);
 }
 
 void Device::lock()
@@ -247,47 +256,120 @@ const std::chrono::system_clock::time_point &Device::lastSeen() const
     return lastSeen_;
 }
 
-void Device::scanLoop()
+void Device::scheduleScan()
 {
-    while (!exit_)
+    if (scanScheduled_)
+        return;
+    scanScheduled_ = true;
+    std::weak_ptr<Device> weak = weak_from_this();
+    auto job = [weak] () {
+        if (auto dev = weak.lock())
+            dev->runScan();
+    };
+    auto debounce = std::chrono::milliseconds(Configurator::instance()->getScanDebounceTime());
+    if (debounce.count() > 0)
+        strand().postAfter(debounce, std::move(job));
+    else
+        strand().post(std::move(job));
+}
+
+void Device::runScan()
+{
+    auto debounce = std::chrono::milliseconds(Configurator::instance()->getScanDebounceTime());
+    std::string uri;
+    std::string path;
+    bool full = false;
     {
         std::unique_lock<std::mutex> lk(mutex_);
-        cv_.wait(lk, [this] { return !queue_.empty(); });
-        std::string uri = static_cast<std::string>(queue_.front());
-        if (uri.empty())
-        {
-            LOG_ERROR(MEDIA_INDEXER_DEVICE, 0, "Deque data is invalid!");
-            continue;
+        scanScheduled_ = false;
+        if (queue_.empty())
+            return;
+
+        // mount events and scan requests come in bursts, wait until
+        // it is quiet and do a single scan for all of them
+        auto now = std::chrono::steady_clock::now();
+        auto quiet = lastRequest_ + debounce;
+        auto deadline = firstRequest_ + debounce * DEVICE_SCAN_DEBOUNCE_MAX;
+        if (debounce.count() > 0 && now < quiet && now < deadline) {
+            scanScheduled_ = true;
+            std::weak_ptr<Device> weak = weak_from_this();
+            strand().postAfter(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::min(quiet, deadline) - now), [weak] () {
+                if (auto dev = weak.lock())
+                    dev->runScan();
+            });
+            return;
         }
-        LOG_DEBUG(MEDIA_INDEXER_DEVICE, "scanLoop start for uri : %s",uri_.c_str());
-        // let the plugin scan the device for media items
-        auto plg = plugin();
-        if (plg == nullptr)
-        {
-            LOG_ERROR(MEDIA_INDEXER_DEVICE, 0, "plugin for %s is not invalid",uri.c_str());
-            break;
+
+        for (const auto &entry : queue_) {
+            if (entry.first.empty())
+                continue;
+            uri = entry.first;
+            if (entry.second.empty())
+                full = true;
+            else
+                path = path.empty() ? entry.second : commonDirectory(path, entry.second);
         }
+        if (queue_.size() > 1)
+            LOG_DEBUG(MEDIA_INDEXER_DEVICE, "%zu scan requests for %s collapsed", queue_.size(), uri_.c_str());
+        queue_.clear();
+    }
+
+    if (uri.empty())
+    {
+        LOG_ERROR(MEDIA_INDEXER_DEVICE, 0, "Deque data is invalid!");
+        fullScan_ = false;
+        return;
+    }
+    if (!available()) {
+        LOG_INFO(MEDIA_INDEXER_DEVICE, 0, "Device '%s' is gone, scan dropped", uri_.c_str());
+        fullScan_ = false;
+        return;
+    }
+    LOG_DEBUG(MEDIA_INDEXER_DEVICE, "runScan start for uri : %s",uri_.c_str());
+    // let the plugin scan the device for media items
+    auto plg = plugin();
+    if (plg == nullptr)
+    {
+        LOG_ERROR(MEDIA_INDEXER_DEVICE, 0, "plugin for %s is not invalid",uri.c_str());
+        fullScan_ = false;
+        return;
+    }
 #if PERFCHECK_ENABLE
-        std::string perfuri = "SCAN-" + uuid();
-        PERF_START(perfuri.c_str());
+    std::string perfuri = "SCAN-" + uuid();
+    PERF_START(perfuri.c_str());
 #endif
-        setState(Device::State::Scanning);
+    auto generation = scanGeneration();
+    setState(Device::State::Scanning);
+    if (full || path.empty())
         plg->scan(uri);
-        setState(Device::State::Parsing);
-        auto obs = observer();
-        if (obs) {
-            obs->notifyDeviceList();
-        }
+    else
+        plg->scanSubtree(uri, path);
 #if PERFCHECK_ENABLE
-        PERF_END(perfuri.c_str());
+    PERF_END(perfuri.c_str());
 #endif
-        if (processingDone())
-            activateCleanUpTask();
-        queue_.pop_front();
+    // the device has gone or another scan has been requested in the
+    // meantime, the results are incomplete
+    if (scanCancelled(generation)) {
+        LOG_INFO(MEDIA_INDEXER_DEVICE, 0, "Scan of '%s' has been cancelled", uri_.c_str());
+        // merge with whatever has been requested so nothing is lost
+        std::unique_lock<std::mutex> lk(mutex_);
+        queue_.emplace_front(uri, full ? "" : path);
+        scheduleScan();
+        return;
     }
+    // files changed from now on are not seen by this walk
+    fullScan_ = false;
+    setState(Device::State::Parsing);
+    auto obs = observer();
+    if (obs) {
+        obs->notifyDeviceList();
+    }
+    if (processingDone())
+        activateCleanUpTask();
 }
 
-bool Device::scan(IMediaItemObserver *observer)
+bool Device::scan(IMediaItemObserver *observer, const std::string &path)
 {
     {
         std::shared_lock lock(lock_);
@@ -303,14 +385,28 @@ bool Device::scan(IMediaItemObserver *observer)
         observer_ = observer;
     }
 
-    LOG_INFO(MEDIA_INDEXER_DEVICE, 0, "Plugin will scan '%s' for us", uri_.c_str());
+    if (path.empty())
+        LOG_INFO(MEDIA_INDEXER_DEVICE, 0, "Plugin will scan '%s' for us", uri_.c_str());
+    else
+        LOG_INFO(MEDIA_INDEXER_DEVICE, 0, "Plugin will scan '%s' below '%s' for us", uri_.c_str(), path.c_str());
+    // a full scan which has not walked the device yet covers the
+    // subtree, restarting it would only throw its work away
+    if (!path.empty() && fullScan_) {
+        LOG_INFO(MEDIA_INDEXER_DEVICE, 0, "'%s' is covered by the full scan of '%s'", path.c_str(), uri_.c_str());
+        return true;
+    }
 #if PERFCHECK_ENABLE
     PERF_START("TOTAL");
 #endif
     resetMediaItemCount();
     std::unique_lock<std::mutex> lk(mutex_);
-    queue_.push_back(uri_);
-    cv_.notify_one();
+    if (path.empty())
+        fullScan_ = true;
+    lastRequest_ = std::chrono::steady_clock::now();
+    if (queue_.empty())
+        firstRequest_ = lastRequest_;
+    queue_.emplace_back(uri_, path);
+    scheduleScan();
     return true;
 }
 
@@ -328,8 +424,24 @@ std::string Device::mountpoint() const
 
 void Device::setMountpoint(const std::string &mp)
 {
+    auto disk = DiskScheduler::instance()->diskOf(mp);
     std::unique_lock lock(lock_);
     mountpoint_ = mp;
+    disk_ = std::move(disk);
+}
+
+std::string Device::disk() const
+{
+    std::shared_lock lock(lock_);
+    return disk_;
+}
+
+Executor::Strand &Device::strand()
+{
+    auto name = disk();
+    if (name.empty())
+        return strand_;
+    return DiskScheduler::instance()->scanStrand(name);
 }
 
 std::shared_ptr<Plugin> Device::plugin() const
@@ -445,6 +557,8 @@ bool Device::processingDone()
                 totalProcessedCount_, totalRemovedCount_.load());
         if ((totalItemCount_ == totalProcessedCount_) && (removeCount_ == totalRemovedCount_)) {
             setState(Device::State::Idle);
+            scannedGeneration_ = scanGeneration_.load();
+            CacheManager::instance()->commitCache(uuid_);
             auto obs = observer();
             if (obs)
                 obs->notifyDeviceScanned();
@@ -467,13 +581,41 @@ bool Device::processingDone()
     return false;
 }
 
+unsigned long Device::scanGeneration() const
+{
+    return scanGeneration_;
+}
+
+bool Device::scanCancelled(unsigned long generation) const
+{
+    return generation != scanGeneration_;
+}
+
+bool Device::scanDone(unsigned long generation) const
+{
+    return scannedGeneration_ >= generation;
+}
+
 void Device::activateCleanUpTask()
 {
-    cleanUpTask_.sendMessage(this, nullptr);
+    // runs after the scan in progress, a cleanup never overlaps with
+    // a scan of the same device
+    std::weak_ptr<Device> weak = weak_from_this();
+    strand().post([weak] () {
+        auto dev = weak.lock();
+        if (!dev)
+            return;
+        LOG_DEBUG(MEDIA_INDEXER_DEVICE, "Clean Up Task start for device '%s'", dev->uri().c_str());
+        auto obs = dev->observer();
+        if (obs)
+            obs->cleanupDevice(dev.get());
+    });
 }
 
 void Device::resetMediaItemCount()
 {
+    // whatever is still on its way belongs to the previous counts
+    scanGeneration_++;
     mediaItemCount_.clear();
     processedCount_.clear();
     removedCount_.clear();
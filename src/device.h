@@ -18,7 +18,7 @@
 
 #include "logging.h"
 #include "mediaitem.h"
-#include "task.h"
+#include "executor.h"
 
 #if PERFCHECK_ENABLE
 #include "performancechecker.h"
@@ -38,7 +38,7 @@
 class Plugin;
 
 /// Base class for devices like MTP or UPnP servers.
-class Device
+class Device : public std::enable_shared_from_this<Device>
 {
 public:
     /// Meta types for devices.
@@ -197,9 +197,11 @@ public:
      *\brief Does device specific media item detection.
      *
      * \param[in] observer Observer class for this device class.
+     * \param[in] path Only rescan below this path if not empty.
      * \return True if device cares of media items, else false.
      */
-    virtual bool scan(IMediaItemObserver *observer = nullptr);
+    virtual bool scan(IMediaItemObserver *observer = nullptr,
+        const std::string &path = "");
 
     /**
      *\brief Gives us the current media item observer.
@@ -222,6 +224,13 @@ public:
      */
     virtual void setMountpoint(const std::string &mp);
 
+    /**
+     * \brief Get the physical disk behind the device mountpoint.
+     *
+     * \return Disk name, empty string if not backed by a local disk.
+     */
+    std::string disk() const;
+
     /**
      * \brief Get plugin for device.
      *
@@ -313,6 +322,36 @@ public:
      */
     void activateCleanUpTask();
 
+    /**
+     * \brief Get the current scan generation.
+     *
+     * The generation changes whenever the device becomes unavailable
+     * or a new scan is requested, work started for an older
+     * generation is dropped.
+     *
+     * \return The scan generation.
+     */
+    unsigned long scanGeneration() const;
+
+    /**
+     * \brief Check if work of a scan generation has been cancelled.
+     *
+     * \param[in] generation The generation the work belongs to.
+     * \return True if the work shall be dropped, else false.
+     */
+    bool scanCancelled(unsigned long generation) const;
+
+    /**
+     * \brief Check if a scan generation has been completed.
+     *
+     * A cancelled generation is completed by the scan which took
+     * over its requests.
+     *
+     * \param[in] generation The generation to check.
+     * \return True if the device has been idle since, else false.
+     */
+    bool scanDone(unsigned long generation) const;
+
     /**
      * \brief Return the media item count for given type.
      *
@@ -336,10 +375,10 @@ public:
     virtual bool createCacheDirectory();
 
     /**
-     * \brief Thread loop for file scanning.
+     * \brief Run the queued scan requests, runs on the device strand.
      *
      */
-    void scanLoop();
+    void runScan();
 
     void init();
 
@@ -365,6 +404,8 @@ private:
     std::string uri_;
     /// Device mountpoint
     std::string mountpoint_;
+    /// Physical disk behind the mountpoint
+    std::string disk_;
     /// Device uuid
     std::string uuid_;
     /// Last seen timestamp of device.
@@ -382,12 +423,23 @@ private:
     int maxAlive_;
     bool newMountedDevice_ = true;
 
-    std::thread task_;
+    /// Schedule runScan() unless already done, must be called with
+    /// mutex_ locked.
+    void scheduleScan();
+
+    /// Strand for scans and cleanups, shared by all devices on the
+    /// same disk.
+    Executor::Strand &strand();
+
     std::mutex mutex_;
     std::mutex pmtx_;
-    std::condition_variable cv_;
-    std::deque<std::string> queue_;
-    bool exit_ = false;
+    /// Queued scans, device uri and subtree path.
+    std::deque<std::pair<std::string, std::string>> queue_;
+    /// runScan() is scheduled and has not taken the queue yet.
+    bool scanScheduled_ = false;
+    /// Time of the first and the last queued scan request.
+    std::chrono::steady_clock::time_point firstRequest_;
+    std::chrono::steady_clock::time_point lastRequest_;
 
     /// Media item observer.
     IMediaItemObserver *observer_;
@@ -406,7 +458,16 @@ private:
     std::atomic<int> totalRemovedCount_ = 0;
     std::atomic<int> removeCount_ = 0;
 
-    Task cleanUpTask_;
+    /// Current scan generation.
+    std::atomic<unsigned long> scanGeneration_ = 0;
+    /// Last scan generation which has been completed.
+    std::atomic<unsigned long> scannedGeneration_ = 0;
+    /// A full scan is queued or still walking the device.
+    std::atomic<bool> fullScan_ = false;
+
+    /// Serializes scans and cleanups of this device on the scan pool
+    /// unless it is on a local disk.
+    Executor::Strand strand_;
 };
 
 /// Useful when iterating over enum.
@@ -0,0 +1,135 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "diskscheduler.h"
+#include "configurator.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+namespace fs = std::filesystem;
+
+std::unique_ptr<DiskScheduler> DiskScheduler::instance_;
+std::mutex DiskScheduler::ctorLock_;
+
+DiskScheduler *DiskScheduler::instance()
+{
+    std::lock_guard<std::mutex> lk(ctorLock_);
+    if (!instance_.get())
+        instance_.reset(new DiskScheduler());
+    return instance_.get();
+}
+
+DiskScheduler::DiskScheduler() :
+    rotationalWorkers_(0)
+{
+    auto workers = Configurator::instance()->getRotationalDiskExtractionWorkers();
+    if (workers > 0)
+        rotationalWorkers_ = static_cast<size_t>(workers);
+}
+
+std::string DiskScheduler::diskOf(const std::string &mountpoint)
+{
+    if (mountpoint.empty())
+        return "";
+
+    // fuse mounts like ntfs-3g have an anonymous device number, they
+    // are found by the mount source instead
+    std::string name;
+    struct stat st;
+    if (stat(mountpoint.c_str(), &st) == 0 && major(st.st_dev) != 0)
+        name = wholeDisk("/sys/dev/block/" + std::to_string(major(st.st_dev)) + ":" +
+            std::to_string(minor(st.st_dev)));
+    if (name.empty()) {
+        auto source = mountSource(mountpoint);
+        if (!source.compare(0, 5, "/dev/"))
+            name = wholeDisk("/sys/class/block/" + fs::path(source).filename().string());
+    }
+    if (name.empty())
+        return "";
+
+    std::lock_guard<std::mutex> lock(lock_);
+    auto &entry = disk(name);
+    LOG_INFO(MEDIA_INDEXER_DEVICE, 0, "Mount point '%s' is on disk '%s'%s", mountpoint.c_str(),
+        name.c_str(), entry.rotational ? " (rotational)" : "");
+    return name;
+}
+
+Executor::Strand &DiskScheduler::scanStrand(const std::string &disk)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return *this->disk(disk).strand;
+}
+
+size_t DiskScheduler::extractionLimit(const std::string &disk)
+{
+    if (disk.empty())
+        return 0;
+    std::lock_guard<std::mutex> lock(lock_);
+    return this->disk(disk).rotational ? rotationalWorkers_ : 0;
+}
+
+DiskScheduler::Disk &DiskScheduler::disk(const std::string &name)
+{
+    auto iter = disks_.find(name);
+    if (iter != disks_.end())
+        return iter->second;
+
+    Disk &entry = disks_[name];
+    entry.strand.reset(new Executor::Strand(Executor::scanInstance()));
+    std::ifstream rotational("/sys/block/" + name + "/queue/rotational");
+    int value = 0;
+    entry.rotational = (rotational >> value) && value;
+    return entry;
+}
+
+std::string DiskScheduler::wholeDisk(const std::string &sysPath)
+{
+    // the entry resolves to .../block/<disk>/<partition> for a
+    // partition and to .../block/<disk> for a whole disk
+    std::error_code ec;
+    auto path = fs::canonical(sysPath, ec);
+    if (ec)
+        return "";
+    if (fs::exists(path / "partition", ec))
+        path = path.parent_path();
+    return path.filename().string();
+}
+
+std::string DiskScheduler::mountSource(const std::string &mountpoint)
+{
+    // <id> <parent> <maj:min> <root> <mount point> <options> ... - <type> <source> ...
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(mountinfo, line)) {
+        std::istringstream fields(line);
+        std::string id, parent, dev, root, point;
+        if (!(fields >> id >> parent >> dev >> root >> point) || point != mountpoint)
+            continue;
+        auto sep = line.find(" - ");
+        if (sep == std::string::npos)
+            continue;
+        std::istringstream tail(line.substr(sep + 3));
+        std::string type, source;
+        if (tail >> type >> source)
+            return source;
+    }
+    return "";
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "executor.h"
+#include "logging.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * \brief Schedules device work by the physical disk behind it.
+ *
+ * Every partition of a USB disk is a device of its own. Scanning two
+ * partitions of one hard disk at once makes the head jump between
+ * them, while two separate sticks can well be scanned in parallel.
+ *
+ * The scheduler maps a mount point to its whole disk through
+ * /sys/dev/block, falling back to the mount source. The devices of
+ * one disk share a scan strand on the executor, so their scans and
+ * cleanups run one after the other while other disks go on in
+ * parallel. Extraction is limited per rotational disk, see
+ * extractionLimit().
+ */
+class DiskScheduler
+{
+public:
+    /**
+     * \brief Get scheduler object.
+     *
+     * \return Singleton object.
+     */
+    static DiskScheduler *instance();
+
+    /**
+     * \brief Find the physical disk behind a mount point.
+     *
+     * \param[in] mountpoint The mount point.
+     * \return The disk name, e.g. "sda", empty if not block backed.
+     */
+    std::string diskOf(const std::string &mountpoint);
+
+    /**
+     * \brief Get the strand for the scans of a disk.
+     *
+     * \param[in] disk The disk name from diskOf().
+     * \return The strand, it lives as long as the process.
+     */
+    Executor::Strand &scanStrand(const std::string &disk);
+
+    /**
+     * \brief Get the number of parallel extractions for a disk.
+     *
+     * \param[in] disk The disk name from diskOf().
+     * \return The limit, 0 is unlimited.
+     */
+    size_t extractionLimit(const std::string &disk);
+
+private:
+    /// Singleton.
+    DiskScheduler();
+
+    struct Disk {
+        std::unique_ptr<Executor::Strand> strand;
+        bool rotational = false;
+    };
+
+    /// Get or create the disk entry, must be called with lock_
+    /// locked.
+    Disk &disk(const std::string &name);
+
+    /// Whole disk name of a /sys/class/block or /sys/dev/block entry.
+    static std::string wholeDisk(const std::string &sysPath);
+
+    /// Device node mounted at a mount point from mountinfo.
+    static std::string mountSource(const std::string &mountpoint);
+
+    static std::unique_ptr<DiskScheduler> instance_;
+    static std::mutex ctorLock_;
+
+    std::mutex lock_;
+    std::map<std::string, Disk> disks_;
+    /// Parallel extractions per rotational disk, 0 is unlimited.
+    size_t rotationalWorkers_;
+};
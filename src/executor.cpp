@@ -0,0 +1,243 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "executor.h"
+#include "configurator.h"
+
+#include <algorithm>
+
+/// Default maximum number of workers.
+#define EXECUTOR_THREADS 4
+/// Default maximum number of scan workers.
+#define EXECUTOR_SCAN_THREADS 4
+/// Time an idle worker waits for work before it leaves.
+#define EXECUTOR_IDLE_MS 30000
+
+Executor *Executor::instance_ = nullptr;
+Executor *Executor::scanInstance_ = nullptr;
+std::mutex Executor::ctorLock_;
+
+/// Shared between the strand and the jobs it has posted to the
+/// executor, the strand owner may be gone before they run.
+struct Executor::Strand::State {
+    /// The pool the jobs run on.
+    Executor *executor;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<Job> queue;
+    /// A drain job is queued in or running on the executor.
+    bool scheduled = false;
+    /// A strand job is running.
+    bool running = false;
+    std::thread::id runner;
+    bool closed = false;
+};
+
+Executor::Strand::Strand(Executor *executor) :
+    state_(std::make_shared<State>())
+{
+    state_->executor = executor;
+}
+
+Executor::Strand::~Strand()
+{
+    close();
+}
+
+bool Executor::Strand::post(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->lock);
+        if (state_->closed)
+            return false;
+    }
+    post(state_, std::move(job));
+    return true;
+}
+
+void Executor::Strand::postAfter(std::chrono::milliseconds delay, Job job)
+{
+    // the timer only queues the job, it runs on the pool of the strand
+    auto state = state_;
+    Executor::instance()->postAfter(delay, [state, job = std::move(job)] () mutable {
+        post(state, std::move(job));
+    });
+}
+
+void Executor::Strand::close()
+{
+    std::deque<Job> dropped;
+    std::unique_lock<std::mutex> lock(state_->lock);
+    state_->closed = true;
+    dropped.swap(state_->queue);
+    if (state_->runner != std::this_thread::get_id())
+        state_->cond.wait(lock, [this] () { return !state_->running; });
+    lock.unlock();
+    // dropped jobs are destroyed without the lock held
+}
+
+void Executor::Strand::post(const std::shared_ptr<State> &state, Job job)
+{
+    std::lock_guard<std::mutex> lock(state->lock);
+    if (state->closed)
+        return;
+    state->queue.push_back(std::move(job));
+    if (state->scheduled)
+        return;
+    state->scheduled = true;
+    if (!state->executor)
+        state->executor = Executor::instance();
+    state->executor->post([state] () { drain(state); });
+}
+
+void Executor::Strand::drain(const std::shared_ptr<State> &state)
+{
+    Job job;
+    {
+        std::lock_guard<std::mutex> lock(state->lock);
+        if (state->closed || state->queue.empty()) {
+            state->scheduled = false;
+            return;
+        }
+        job = std::move(state->queue.front());
+        state->queue.pop_front();
+        state->running = true;
+        state->runner = std::this_thread::get_id();
+    }
+
+    try {
+        job();
+    } catch (const std::exception &e) {
+        LOG_ERROR(MEDIA_INDEXER_TASK, 0, "Strand job failure: %s", e.what());
+    } catch (...) {
+        LOG_ERROR(MEDIA_INDEXER_TASK, 0, "Strand job failure by unexpected failure");
+    }
+    job = Job();
+
+    std::lock_guard<std::mutex> lock(state->lock);
+    state->running = false;
+    state->runner = std::thread::id();
+    state->cond.notify_all();
+    // one job per turn, the next one queues up behind the other work
+    if (!state->closed && !state->queue.empty())
+        state->executor->post([state] () { drain(state); });
+    else
+        state->scheduled = false;
+}
+
+Executor *Executor::instance()
+{
+    std::lock_guard<std::mutex> lk(ctorLock_);
+    // never destroyed, detached workers may still be running at exit
+    if (!instance_) {
+        auto threads = Configurator::instance()->getExecutorThreads();
+        instance_ = new Executor("Executor", threads > 0 ? static_cast<size_t>(threads) : EXECUTOR_THREADS);
+    }
+    return instance_;
+}
+
+Executor *Executor::scanInstance()
+{
+    std::lock_guard<std::mutex> lk(ctorLock_);
+    // never destroyed, see instance()
+    if (!scanInstance_) {
+        auto threads = Configurator::instance()->getScanThreads();
+        scanInstance_ = new Executor("Scan executor",
+            threads > 0 ? static_cast<size_t>(threads) : EXECUTOR_SCAN_THREADS);
+    }
+    return scanInstance_;
+}
+
+Executor::Executor(const char *name, size_t maxThreads) :
+    name_(name),
+    maxThreads_(maxThreads),
+    threads_(0),
+    idle_(0)
+{
+    LOG_INFO(MEDIA_INDEXER_TASK, 0, "%s with up to %zu threads", name_, maxThreads_);
+}
+
+void Executor::post(Job job)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    jobs_.push_back(std::move(job));
+    spawn();
+    cond_.notify_one();
+}
+
+void Executor::postAfter(std::chrono::milliseconds delay, Job job)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    timers_.emplace(Clock::now() + delay, std::move(job));
+    spawn();
+    // an idle worker has to wait for the new deadline
+    cond_.notify_all();
+}
+
+void Executor::spawn()
+{
+    // one idle worker per ready job, at least one for the timers
+    if (idle_ >= std::max<size_t>(jobs_.size(), 1) || threads_ >= maxThreads_)
+        return;
+    threads_++;
+    idle_++;
+    std::thread(&Executor::run, this).detach();
+}
+
+void Executor::run()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    auto idleSince = Clock::now();
+    for (;;) {
+        // move the due timers to the ready jobs
+        auto now = Clock::now();
+        while (!timers_.empty() && timers_.begin()->first <= now) {
+            jobs_.push_back(std::move(timers_.begin()->second));
+            timers_.erase(timers_.begin());
+        }
+
+        if (!jobs_.empty()) {
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            idle_--;
+            lock.unlock();
+            try {
+                job();
+            } catch (const std::exception &e) {
+                LOG_ERROR(MEDIA_INDEXER_TASK, 0, "Executor job failure: %s", e.what());
+            } catch (...) {
+                LOG_ERROR(MEDIA_INDEXER_TASK, 0, "Executor job failure by unexpected failure");
+            }
+            job = Job();
+            lock.lock();
+            idle_++;
+            idleSince = Clock::now();
+            continue;
+        }
+
+        // the last idle worker stays while timers are pending
+        auto deadline = idleSince + std::chrono::milliseconds(EXECUTOR_IDLE_MS);
+        if (!timers_.empty())
+            deadline = std::min(deadline, timers_.begin()->first);
+        if (cond_.wait_until(lock, deadline) == std::cv_status::timeout &&
+            jobs_.empty() && Clock::now() >= idleSince + std::chrono::milliseconds(EXECUTOR_IDLE_MS) &&
+            (timers_.empty() || idle_ > 1)) {
+            threads_--;
+            idle_--;
+            return;
+        }
+    }
+}
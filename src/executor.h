@@ -0,0 +1,205 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+/**
+ * \brief Shared worker pool for device scans, cleanups and discovery.
+ *
+ * Each device used to own a scan thread and a cleanup thread and
+ * every discovered UPnP server got a thread of its own, most of them
+ * idle most of the time. The executor starts workers on demand up to
+ * a configured maximum and lets them go after a while without work.
+ *
+ * Work which must not overlap, like the scans and cleanups of one
+ * device, is posted to a Strand. A strand runs its jobs one after the
+ * other in posting order on whatever worker is free and gives the
+ * worker back after each job so other strands are not starved.
+ *
+ * A device scan keeps its worker until the walk is done, and it may
+ * wait for the indexing governor for a long time. Scans and cleanups
+ * therefore run on strands of a pool of their own, its maximum number
+ * of workers is the number of disks scanned in parallel. Discovery
+ * and the timers of all strands stay on the shared pool and are never
+ * starved by scans.
+ */
+class Executor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Move-only unit of work.
+    class Job
+    {
+    public:
+        Job() = default;
+        template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Job>::value>>
+        Job(F &&func) :
+            impl_(new Impl<std::decay_t<F>>(std::forward<F>(func)))
+        {
+        }
+        Job(Job &&) = default;
+        Job &operator=(Job &&) = default;
+
+        explicit operator bool() const { return !!impl_; }
+        void operator()() { impl_->call(); }
+
+    private:
+        struct Base {
+            virtual ~Base() = default;
+            virtual void call() = 0;
+        };
+        template<typename F>
+        struct Impl : Base {
+            template<typename G>
+            explicit Impl(G &&func) : func_(std::forward<G>(func)) {}
+            void call() override { func_(); }
+            F func_;
+        };
+        std::unique_ptr<Base> impl_;
+    };
+
+    /// Runs its jobs one at a time in posting order.
+    class Strand
+    {
+    public:
+        /**
+         * \brief Construct strand.
+         *
+         * \param[in] executor The pool to run the jobs on, the shared
+         * pool if none is given.
+         */
+        explicit Strand(Executor *executor = nullptr);
+        /// Drops the queued jobs and waits for the running one.
+        ~Strand();
+        Strand(const Strand &) = delete;
+        Strand &operator=(const Strand &) = delete;
+
+        /**
+         * \brief Queue a job.
+         *
+         * \param[in] job The job.
+         * \return False if the strand is closed.
+         */
+        bool post(Job job);
+
+        /**
+         * \brief Queue a job once a delay has passed.
+         *
+         * \param[in] delay Time to wait before queueing.
+         * \param[in] job The job.
+         */
+        void postAfter(std::chrono::milliseconds delay, Job job);
+
+        /// Queue a callable and get a future for its result.
+        template<typename F>
+        auto submit(F &&func) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+        {
+            std::packaged_task<std::invoke_result_t<std::decay_t<F>>()> task(std::forward<F>(func));
+            auto result = task.get_future();
+            post(std::move(task));
+            return result;
+        }
+
+        /// Drop the queued jobs, wait for the running one and refuse
+        /// further jobs. Does not wait if called from the running job.
+        void close();
+
+    private:
+        struct State;
+        static void post(const std::shared_ptr<State> &state, Job job);
+        static void drain(const std::shared_ptr<State> &state);
+
+        std::shared_ptr<State> state_;
+    };
+
+    /**
+     * \brief Get executor object.
+     *
+     * \return Singleton object.
+     */
+    static Executor *instance();
+
+    /**
+     * \brief Get the pool for device scans and cleanups.
+     *
+     * \return Singleton object.
+     */
+    static Executor *scanInstance();
+
+    /**
+     * \brief Queue a job.
+     *
+     * \param[in] job The job.
+     */
+    void post(Job job);
+
+    /**
+     * \brief Queue a job once a delay has passed.
+     *
+     * \param[in] delay Time to wait before queueing.
+     * \param[in] job The job.
+     */
+    void postAfter(std::chrono::milliseconds delay, Job job);
+
+    /// Queue a callable and get a future for its result.
+    template<typename F>
+    auto submit(F &&func) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        std::packaged_task<std::invoke_result_t<std::decay_t<F>>()> task(std::forward<F>(func));
+        auto result = task.get_future();
+        post(std::move(task));
+        return result;
+    }
+
+private:
+    /// Singleton.
+    Executor(const char *name, size_t maxThreads);
+
+    /// Start a worker unless enough are idle, must be called with
+    /// lock_ locked.
+    void spawn();
+
+    /// Worker thread.
+    void run();
+
+    static Executor *instance_;
+    static Executor *scanInstance_;
+    static std::mutex ctorLock_;
+
+    std::mutex lock_;
+    std::condition_variable cond_;
+    /// Jobs ready to run.
+    std::deque<Job> jobs_;
+    /// Delayed jobs by due time.
+    std::multimap<Clock::time_point, Job> timers_;
+    const char *name_;
+    size_t maxThreads_;
+    size_t threads_;
+    size_t idle_;
+};
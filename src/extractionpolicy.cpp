@@ -0,0 +1,75 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "extractionpolicy.h"
+#include "configurator.h"
+
+#include <algorithm>
+
+std::unique_ptr<ExtractionPolicy> ExtractionPolicy::instance_;
+std::mutex ExtractionPolicy::ctorLock_;
+
+ExtractionPolicy *ExtractionPolicy::instance()
+{
+    std::lock_guard<std::mutex> lk(ctorLock_);
+    if (!instance_.get())
+        instance_.reset(new ExtractionPolicy());
+    return instance_.get();
+}
+
+ExtractionPolicy::ExtractionPolicy()
+{
+    for (const auto &config : Configurator::instance()->getExtractionPolicy()) {
+        Rule rule;
+        rule.type = config.type;
+        rule.device = config.device;
+        rule.minSize = static_cast<unsigned long>(std::max(config.minSize, 0)) << 20;
+        rule.decision.meta = action(config.meta);
+        rule.decision.thumbnail = action(config.thumbnail);
+        // the thumbnail comes out of the extractor, it cannot be
+        // there before the meta data
+        if (rule.decision.meta != Action::Now && rule.decision.thumbnail == Action::Now)
+            rule.decision.thumbnail = Action::Defer;
+        rules_.push_back(std::move(rule));
+    }
+}
+
+ExtractionPolicy::Decision ExtractionPolicy::decide(const MediaItem &mediaItem) const
+{
+    const auto &uri = mediaItem.uri();
+    auto scheme = uri.substr(0, uri.find("://"));
+    for (const auto &rule : rules_) {
+        if (rule.type != MediaItem::Type::EOL && rule.type != mediaItem.type())
+            continue;
+        if (!rule.device.empty() && rule.device != scheme)
+            continue;
+        if (mediaItem.fileSize() < rule.minSize)
+            continue;
+        return rule.decision;
+    }
+    return Decision();
+}
+
+ExtractionPolicy::Action ExtractionPolicy::action(const std::string &name)
+{
+    if (name == "defer")
+        return Action::Defer;
+    if (name == "skip")
+        return Action::Skip;
+    if (name != "now")
+        LOG_WARNING(MEDIA_INDEXER_CONFIGURATOR, 0, "Unknown extraction policy action '%s'", name.c_str());
+    return Action::Now;
+}
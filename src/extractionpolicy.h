@@ -0,0 +1,91 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+#include "mediaitem.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Decides how much of a media item is extracted when.
+ *
+ * The full extraction of a huge recording takes long and a video
+ * thumbnail needs a decode pipeline. The configured rules match the
+ * media type, the file size and the device class, the first matching
+ * rule decides for the meta data and for the thumbnail:
+ *
+ * - now: extracted during the scan.
+ * - defer: the scan only stores what the file system knows, the rest
+ *   is extracted on the first meta data request of a client.
+ * - skip: never extracted.
+ *
+ * Media items without a matching rule are extracted in full.
+ */
+class ExtractionPolicy
+{
+public:
+    /// What to do with a part of the extraction.
+    enum class Action {
+        Now,
+        Defer,
+        Skip
+    };
+
+    /// The outcome for a media item.
+    struct Decision {
+        Action meta = Action::Now;
+        Action thumbnail = Action::Now;
+    };
+
+    /**
+     * \brief Get policy object.
+     *
+     * \return Singleton object.
+     */
+    static ExtractionPolicy *instance();
+
+    /**
+     * \brief Look up the rule for a media item.
+     *
+     * \param[in] mediaItem The media item.
+     * \return The decision of the first matching rule.
+     */
+    Decision decide(const MediaItem &mediaItem) const;
+
+private:
+    struct Rule {
+        MediaItem::Type type;
+        std::string device;
+        unsigned long minSize;
+        Decision decision;
+    };
+
+    /// Singleton.
+    ExtractionPolicy();
+
+    /// Map a configured action name, unknown names extract now.
+    static Action action(const std::string &name);
+
+    static std::unique_ptr<ExtractionPolicy> instance_;
+    static std::mutex ctorLock_;
+
+    std::vector<Rule> rules_;
+};
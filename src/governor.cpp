@@ -0,0 +1,194 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "governor.h"
+#include "configurator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <time.h>
+
+/// Share of the pressure threshold below which throttling ends.
+#define GOVERNOR_RESUME_SHARE 0.5
+
+std::unique_ptr<Governor> Governor::instance_;
+std::mutex Governor::ctorLock_;
+
+Governor::Slot::Slot(Stage stage) :
+    stage_(stage)
+{
+    Governor::instance()->acquire(stage_);
+}
+
+Governor::Slot::~Slot()
+{
+    Governor::instance()->release(stage_);
+}
+
+Governor *Governor::instance()
+{
+    std::lock_guard<std::mutex> lk(ctorLock_);
+    if (!instance_.get())
+        instance_.reset(new Governor());
+    return instance_.get();
+}
+
+Governor::Governor() :
+    mode_(Mode::Full),
+    playback_(false),
+    pressured_(false),
+    used_(),
+    throttled_()
+{
+    const auto &config = Configurator::instance()->getGovernorConfig();
+    bootDelay_ = std::chrono::milliseconds(std::max(config.bootDelay, 0));
+    poll_ = std::chrono::milliseconds(std::max(config.pollInterval, 100));
+    playbackTimeout_ = std::chrono::milliseconds(std::max(config.playbackTimeout, 0));
+    threshold_ = config.pressureThreshold;
+    throttled_[static_cast<size_t>(Stage::Walk)] = static_cast<size_t>(std::max(config.throttledWalkers, 0));
+    throttled_[static_cast<size_t>(Stage::Extract)] = static_cast<size_t>(std::max(config.throttledExtractors, 0));
+
+    std::lock_guard<std::mutex> lock(lock_);
+    refresh();
+}
+
+void Governor::acquire(Stage stage)
+{
+    auto idx = static_cast<size_t>(stage);
+    std::unique_lock<std::mutex> lock(lock_);
+    for (;;) {
+        refresh();
+        auto max = limit(stage);
+        if (mode_ == Mode::Full || used_[idx] < max)
+            break;
+        // wake up for the next sample, a release or a playback change
+        cond_.wait_for(lock, poll_);
+    }
+    used_[idx]++;
+}
+
+void Governor::release(Stage stage)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    used_[static_cast<size_t>(stage)]--;
+    cond_.notify_all();
+}
+
+bool Governor::limited()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return mode_ != Mode::Full;
+}
+
+void Governor::setPlaybackActive(bool active)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (active)
+        playbackEnd_ = std::chrono::steady_clock::now() + playbackTimeout_;
+    if (playback_ == active)
+        return;
+    LOG_INFO(MEDIA_INDEXER_MEDIAINDEXER, 0, "Playback %s", active ? "started" : "stopped");
+    playback_ = active;
+    // take the new state into account right away
+    sampled_ = std::chrono::steady_clock::time_point();
+    refresh();
+    cond_.notify_all();
+}
+
+void Governor::refresh()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - sampled_ < poll_)
+        return;
+    sampled_ = now;
+
+    // the player has not renewed the playback, it may be gone
+    if (playback_ && playbackTimeout_.count() && now >= playbackEnd_) {
+        LOG_INFO(MEDIA_INDEXER_MEDIAINDEXER, 0, "Playback expired");
+        playback_ = false;
+    }
+
+    auto mode = Mode::Full;
+    if (uptime() < bootDelay_) {
+        mode = Mode::Boot;
+    } else {
+        if (threshold_ > 0) {
+            auto level = std::max(pressure("cpu"), pressure("io"));
+            if (level > threshold_)
+                pressured_ = true;
+            else if (level < threshold_ * GOVERNOR_RESUME_SHARE)
+                pressured_ = false;
+        }
+        if (playback_ || pressured_)
+            mode = Mode::Throttled;
+    }
+
+    if (mode != mode_) {
+        LOG_INFO(MEDIA_INDEXER_MEDIAINDEXER, 0, "Indexing governor %s -> %s", modeName(mode_),
+            modeName(mode));
+        mode_ = mode;
+        cond_.notify_all();
+    }
+}
+
+size_t Governor::limit(Stage stage) const
+{
+    switch (mode_) {
+    case Mode::Boot:
+        return 0;
+    case Mode::Throttled:
+        return throttled_[static_cast<size_t>(stage)];
+    default:
+        return 0;
+    }
+}
+
+const char *Governor::modeName(Mode mode)
+{
+    switch (mode) {
+    case Mode::Boot:
+        return "boot";
+    case Mode::Throttled:
+        return "throttled";
+    default:
+        return "full";
+    }
+}
+
+std::chrono::milliseconds Governor::uptime()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) != 0)
+        return std::chrono::milliseconds::max();
+    return std::chrono::seconds(ts.tv_sec) +
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(ts.tv_nsec));
+}
+
+double Governor::pressure(const char *resource)
+{
+    // some avg10=1.23 avg60=0.50 avg300=0.12 total=12345
+    std::ifstream file(std::string("/proc/pressure/") + resource);
+    std::string line;
+    if (!std::getline(file, line) || line.compare(0, 5, "some "))
+        return 0;
+    auto pos = line.find("avg10=");
+    if (pos == std::string::npos)
+        return 0;
+    return std::strtod(line.c_str() + pos + 6, nullptr);
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+/**
+ * \brief Holds indexing back while the system is busy otherwise.
+ *
+ * Indexing competes with the boot and with media playback, the
+ * extractors and thumbnail decodes make playback stutter. Directory
+ * walkers and extraction workers take a slot of their stage for each
+ * directory or media item. The number of slots depends on the mode:
+ *
+ * - Boot: until the system is up for the configured settle time no
+ *   stage gets a slot.
+ * - Throttled: while a playback is active or the cpu or io pressure
+ *   from /proc/pressure is above the threshold each stage gets its
+ *   configured throttled number of slots, 0 pauses it. A playback
+ *   which is not renewed within the playback timeout ends, a crashed
+ *   player does not throttle indexing for good.
+ * - Full: no limits beyond the ones of the stages themselves.
+ *
+ * There is no thread of its own, waiting workers sample the pressure
+ * when the last sample is older than the poll interval.
+ */
+class Governor
+{
+public:
+    /// The governed stages.
+    enum class Stage {
+        Walk,    ///< Reading a directory.
+        Extract, ///< Extracting one media item.
+        EOL
+    };
+
+    /// Holds a slot of a stage while in scope.
+    class Slot
+    {
+    public:
+        explicit Slot(Stage stage);
+        ~Slot();
+        Slot(const Slot &) = delete;
+        Slot &operator=(const Slot &) = delete;
+
+    private:
+        Stage stage_;
+    };
+
+    /**
+     * \brief Get governor object.
+     *
+     * \return Singleton object.
+     */
+    static Governor *instance();
+
+    /**
+     * \brief Take a slot, blocks while the stage has none left.
+     *
+     * Must not be called from the main loop.
+     *
+     * \param[in] stage The stage.
+     */
+    void acquire(Stage stage);
+
+    /**
+     * \brief Give a slot back.
+     *
+     * \param[in] stage The stage.
+     */
+    void release(Stage stage);
+
+    /// Whether the stages are held back right now.
+    bool limited();
+
+    /**
+     * \brief Tell whether a foreground media playback is active.
+     *
+     * An active playback has to be renewed within the playback
+     * timeout.
+     *
+     * \param[in] active Playback state.
+     */
+    void setPlaybackActive(bool active);
+
+private:
+    enum class Mode {
+        Boot,
+        Throttled,
+        Full
+    };
+
+    /// Singleton.
+    Governor();
+
+    /// Update the mode if the last sample is too old, must be called
+    /// with lock_ locked.
+    void refresh();
+
+    /// Slots of a stage in the current mode, 0 means none for Boot
+    /// and Throttled and unlimited for Full.
+    size_t limit(Stage stage) const;
+
+    static const char *modeName(Mode mode);
+
+    /// Time since boot.
+    static std::chrono::milliseconds uptime();
+
+    /// The "some avg10" share from a /proc/pressure file in percent.
+    static double pressure(const char *resource);
+
+    static std::unique_ptr<Governor> instance_;
+    static std::mutex ctorLock_;
+
+    std::mutex lock_;
+    std::condition_variable cond_;
+    Mode mode_;
+    bool playback_;
+    /// An active playback ends at this point unless renewed.
+    std::chrono::steady_clock::time_point playbackEnd_;
+    /// Pressure has been above the threshold and not yet below the
+    /// resume level.
+    bool pressured_;
+    std::chrono::steady_clock::time_point sampled_;
+    std::array<size_t, static_cast<size_t>(Stage::EOL)> used_;
+    std::array<size_t, static_cast<size_t>(Stage::EOL)> throttled_;
+    std::chrono::milliseconds bootDelay_;
+    std::chrono::milliseconds poll_;
+    std::chrono::milliseconds playbackTimeout_;
+    double threshold_;
+};
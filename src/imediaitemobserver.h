@@ -66,6 +66,15 @@ public:
     virtual void flushUnflagDirty(Device* dev) = 0;
 
     virtual void flushDeleteItems(Device* dev) = 0;
+
+    /**
+     * \brief Called when the file tree walk of a device is complete,
+     * the rows of the found media items can be sent right away.
+     *
+     * \param[in] dev The device.
+     */
+    virtual void flushStatRows(Device* dev) = 0;
+
     /**
      * \brief notify after specified device has been scanned.
      *
@@ -82,6 +91,16 @@ public:
 
     virtual void removeMediaItem(std::unique_ptr<MediaItem> mediaItem) = 0;
 
+    /**
+     * \brief Called if a known media item has been moved, the stored
+     * meta data is taken over for the new location.
+     *
+     * \param[in] mediaItem The media item at its new location.
+     * \param[in] oldUri The uri the media item has been stored with.
+     */
+    virtual void renameMediaItem(std::unique_ptr<MediaItem> mediaItem,
+        const std::string &oldUri) = 0;
+
 protected:
     IMediaItemObserver() {};
 };
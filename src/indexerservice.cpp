@@ -25,6 +25,8 @@
 #include "dbconnector/devicedb.h"
 #include "dbconnector/mediadb.h"
 #include "indexerserviceclientsmgrimpl.h"
+#include "governor.h"
+#include "interesttracker.h"
 
 #include <glib.h>
 
@@ -71,6 +73,7 @@ LSMethod IndexerService::serviceMethods_[] = {
     { "getImageMetadata", IndexerService::onImageMetadataGet, LUNA_METHOD_FLAGS_NONE },
     { "requestDelete", IndexerService::onRequestDelete, LUNA_METHOD_FLAGS_NONE },
     { "requestMediaScan", IndexerService::onRequestMediaScan, LUNA_METHOD_FLAGS_NONE },
+    { "setPlaybackState", IndexerService::onSetPlaybackState, LUNA_METHOD_FLAGS_NONE },
     { nullptr, nullptr}
 };
 
@@ -560,6 +563,8 @@ bool IndexerService::onAudioListGet(LSHandle *lsHandle, LSMessage *msg, void *ct
 
 bool IndexerService::getAudioList(const std::string &uri, int count, LSMessage *msg, bool expand)
 {
+    // what is queried now shall be extracted first
+    InterestTracker::instance()->touch(uri);
     MediaDb *mdb = MediaDb::instance();
     return mdb->getAudioList(uri, count, msg, expand);
 }
@@ -684,6 +689,8 @@ bool IndexerService::onVideoListGet(LSHandle *lsHandle, LSMessage *msg, void *ct
 
 bool IndexerService::getVideoList(const std::string &uri, int count, LSMessage *msg, bool expand)
 {
+    // what is queried now shall be extracted first
+    InterestTracker::instance()->touch(uri);
     MediaDb *mdb = MediaDb::instance();
     return mdb->getVideoList(uri, count, msg, expand);
 }
@@ -808,6 +815,8 @@ bool IndexerService::onImageListGet(LSHandle *lsHandle, LSMessage *msg, void *ct
 
 bool IndexerService::getImageList(const std::string &uri, int count, LSMessage *msg, bool expand)
 {
+    // what is queried now shall be extracted first
+    InterestTracker::instance()->touch(uri);
     MediaDb *mdb = MediaDb::instance();
     return mdb->getImageList(uri, count, msg, expand);
 }
@@ -940,15 +949,32 @@ bool IndexerService::requestMediaScan(LSMessage *msg)
 
     LOG_INFO(MEDIA_INDEXER_INDEXERSERVICE, 0, "call IndexerService onRequestMediaScan");
     bool scanned = false;
+    std::shared_ptr<Device> device;
     // generate response
     auto reply = pbnjson::Object();
     for (auto const &[uri, plg] : indexer_->plugins_) {
         for (auto const &[uri, dev] : plg->devices()) {
             dev->lock();
+            auto mp = dev->mountpoint();
+            while (mp.size() > 1 && mp.back() == '/')
+                mp.pop_back();
             if (dev->available() && (!dev->mountpoint().compare(0, path.size(), path))) {
                 LOG_INFO(MEDIA_INDEXER_INDEXERSERVICE, 0, "Media Scan start for device %s", dev->uri().c_str());
                 dev->scan();
                 scanned = true;
+                device = dev;
+                dev->unlock();
+                break;
+            }
+            // a path below the mountpoint only needs that subtree
+            // to be rescanned
+            if (dev->available() && !mp.empty() && path.size() > mp.size() &&
+                !path.compare(0, mp.size(), mp) && path[mp.size()] == '/') {
+                LOG_INFO(MEDIA_INDEXER_INDEXERSERVICE, 0, "Media Scan start for '%s' on device %s",
+                    path.c_str(), dev->uri().c_str());
+                dev->scan(nullptr, path);
+                scanned = true;
+                device = dev;
                 dev->unlock();
                 break;
             }
@@ -956,7 +982,9 @@ bool IndexerService::requestMediaScan(LSMessage *msg)
         }
     }
 
-    if (scanned && waitForScan()) {
+    // only the scan of this device answers the request, a running
+    // full scan may have covered the path already
+    if (scanned && waitForScan(device.get(), device->scanGeneration())) {
         reply.put("returnValue", true);
         reply.put("errorCode", 0);
         reply.put("errorText", "No Error");
@@ -975,15 +1003,62 @@ bool IndexerService::requestMediaScan(LSMessage *msg)
     return true;
 }
 
-bool IndexerService::waitForScan()
+bool IndexerService::onSetPlaybackState(LSHandle *lsHandle, LSMessage *msg, void *ctx)
+{
+    LOG_INFO(MEDIA_INDEXER_INDEXERSERVICE, 0, "start onSetPlaybackState");
+
+    IndexerService *is = static_cast<IndexerService *>(ctx);
+    return is->setPlaybackState(msg);
+}
+
+bool IndexerService::setPlaybackState(LSMessage *msg)
+{
+    // parse incoming message
+    const char *payload = LSMessageGetPayload(msg);
+    pbnjson::JDomParser parser;
+
+    if (!parser.parse(payload, pbnjson::JSchema::AllSchema())) {
+        LOG_ERROR(MEDIA_INDEXER_INDEXERSERVICE, 0, "Invalid %s request: %s", LSMessageGetMethod(msg),
+            payload);
+        return false;
+    }
+
+    auto domTree(parser.getDom());
+    RETURN_IF(!domTree.hasKey("active"), false, "client must specify active");
+
+    // indexing is throttled while a foreground playback is active, the
+    // player repeats active within the playback timeout
+    Governor::instance()->setPlaybackActive(domTree["active"].asBool());
+
+    auto reply = pbnjson::Object();
+    reply.put("returnValue", true);
+    reply.put("errorCode", 0);
+    reply.put("errorText", "No Error");
+
+    LSError lsError;
+    LSErrorInit(&lsError);
+
+    if (!LSMessageReply(lsHandle_, msg, reply.stringify().c_str(), &lsError)) {
+        LOG_ERROR(MEDIA_INDEXER_INDEXERSERVICE, 0, "Message reply error");
+        return false;
+    }
+    return true;
+}
+
+bool IndexerService::waitForScan(const Device *device, unsigned long generation)
 {
     std::unique_lock<std::mutex> lk(scanMutex_);
-    return !(scanCv_.wait_for(lk, std::chrono::seconds(SCAN_TIMEOUT)) == std::cv_status::timeout);
+    return scanCv_.wait_for(lk, std::chrono::seconds(SCAN_TIMEOUT),
+        [device, generation] () { return device->scanDone(generation); });
 }
 
 bool IndexerService::notifyScanDone()
 {
-    scanCv_.notify_one();
+    // the waiters check their device under the lock, none misses it
+    {
+        std::lock_guard<std::mutex> lk(scanMutex_);
+    }
+    scanCv_.notify_all();
     return true;
 }
 
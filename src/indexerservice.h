@@ -27,6 +27,7 @@
 #include <memory>
 
 class MediaIndexer;
+class Device;
 
 /**
  * \brief Indexer service class.
@@ -291,6 +292,15 @@ private:
      */
     static bool onRequestMediaScan(LSHandle *lsHandle, LSMessage *msg, void *ctx);
 
+    /**
+     * \brief Callback for setPlaybackState() Luna method.
+     *
+     * \param[in] lsHandle Luna service handle.
+     * \param[in] msg The Luna message.
+     * \param[in] ctx Pointer to IndexerService class instance.
+     */
+    static bool onSetPlaybackState(LSHandle *lsHandle, LSMessage *msg, void *ctx);
+
     static bool callbackSubscriptionCancel(LSHandle *lshandle, LSMessage *msg,
                                            void *ctx);
 
@@ -302,7 +312,16 @@ private:
 
     bool requestMediaScan(LSMessage *msg);
 
-    bool waitForScan();
+    bool setPlaybackState(LSMessage *msg);
+
+    /**
+     * \brief Wait until a device has completed a scan.
+     *
+     * \param[in] device The scanned device.
+     * \param[in] generation The scan generation to wait for.
+     * \return False on timeout, else true.
+     */
+    bool waitForScan(const Device *device, unsigned long generation);
 
     /**
      * \brief Combines functionality for onPluginGet and onPluginPut.
@@ -0,0 +1,98 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "interesttracker.h"
+#include "configurator.h"
+#include "mediaparser.h"
+
+#include <algorithm>
+
+/// Maximum number of prefixes, the oldest one goes first.
+#define INTEREST_MAX_PREFIXES 16
+
+std::unique_ptr<InterestTracker> InterestTracker::instance_;
+std::mutex InterestTracker::ctorLock_;
+
+InterestTracker *InterestTracker::instance()
+{
+    std::lock_guard<std::mutex> lk(ctorLock_);
+    if (!instance_.get())
+        instance_.reset(new InterestTracker());
+    return instance_.get();
+}
+
+InterestTracker::InterestTracker() :
+    ttl_(std::max(Configurator::instance()->getInterestTimeout(), 0))
+{
+    // nothing to be done here
+}
+
+void InterestTracker::touch(const std::string &prefix)
+{
+    // an interest in everything is the same as none
+    if (prefix.empty() || ttl_.count() == 0)
+        return;
+
+    bool added;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto now = std::chrono::steady_clock::now();
+        expire(now);
+        added = prefixes_.find(prefix) == prefixes_.end();
+        if (added && prefixes_.size() >= INTEREST_MAX_PREFIXES) {
+            auto oldest = std::min_element(prefixes_.begin(), prefixes_.end(),
+                [] (const auto &a, const auto &b) { return a.second < b.second; });
+            prefixes_.erase(oldest);
+        }
+        prefixes_[prefix] = now + ttl_;
+    }
+
+    // the parser asks back for matches, the lock must not be held
+    if (added) {
+        LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "Interest in '%s'", prefix.c_str());
+        MediaParser::instance()->promote();
+    }
+}
+
+bool InterestTracker::matches(const std::string &uri)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (prefixes_.empty())
+        return false;
+    expire(std::chrono::steady_clock::now());
+    for (const auto &prefix : prefixes_) {
+        if (!uri.compare(0, prefix.first.size(), prefix.first))
+            return true;
+    }
+    return false;
+}
+
+bool InterestTracker::empty()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    expire(std::chrono::steady_clock::now());
+    return prefixes_.empty();
+}
+
+void InterestTracker::expire(std::chrono::steady_clock::time_point now)
+{
+    for (auto iter = prefixes_.begin(); iter != prefixes_.end();) {
+        if (iter->second <= now)
+            iter = prefixes_.erase(iter);
+        else
+            ++iter;
+    }
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * \brief Remembers what clients are looking at.
+ *
+ * List and meta data queries name a device uri or a media item uri
+ * prefix. The prefixes queried within the last interest-ttl-ms are
+ * of interest, the meta data extraction takes queued media items
+ * below them first so the view of the user fills in before the rest
+ * of the device.
+ */
+class InterestTracker
+{
+public:
+    /**
+     * \brief Get tracker object.
+     *
+     * \return Singleton object.
+     */
+    static InterestTracker *instance();
+
+    /**
+     * \brief Note a client query.
+     *
+     * Promotes the queued media items below a new prefix.
+     *
+     * \param[in] prefix The queried uri or uri prefix.
+     */
+    void touch(const std::string &prefix);
+
+    /**
+     * \brief Check if a media item is of interest.
+     *
+     * \param[in] uri The media item uri.
+     * \return True if the uri is below a prefix of interest.
+     */
+    bool matches(const std::string &uri);
+
+    /// Whether any prefix is of interest.
+    bool empty();
+
+private:
+    /// Singleton.
+    InterestTracker();
+
+    /// Drop expired prefixes, must be called with lock_ locked.
+    void expire(std::chrono::steady_clock::time_point now);
+
+    static std::unique_ptr<InterestTracker> instance_;
+    static std::mutex ctorLock_;
+
+    std::mutex lock_;
+    /// Prefixes with their expiry time.
+    std::map<std::string, std::chrono::steady_clock::time_point> prefixes_;
+    std::chrono::milliseconds ttl_;
+};
@@ -35,6 +35,7 @@
 #define MEDIA_INDEXER_MEDIAITEM "MEDIAITEM"
 #define MEDIA_INDEXER_MEDIAPARSER "MEDIAPARSER"
 #define MEDIA_INDEXER_TASK "TASK"
+#define MEDIA_INDEXER_PIPELINE "PIPELINE"
 #define MEDIA_INDEXER_CACHE "CACHE"
 #define MEDIA_INDEXER_CACHEMANAGER "CACHEMANAGER"
 #define MEDIA_INDEXER_DBCONNECTOR "DBCONNECTOR"
@@ -51,6 +52,7 @@
 #define MEDIA_INDEXER_MTP "MTP"
 #define MEDIA_INDEXER_PLUGIN "PLUGIN"
 #define MEDIA_INDEXER_PLUGINFACTORY "PLUGINFACTORY"
+#define MEDIA_INDEXER_FSWATCHER "FSWATCHER"
 #define MEDIA_INDEXER_STORAGE "STORAGE"
 #define MEDIA_INDEXER_UPNP "UPNP"
 
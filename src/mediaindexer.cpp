@@ -234,6 +234,12 @@ void MediaIndexer::deviceModified(std::shared_ptr<Device> device)
 
 void MediaIndexer::newMediaItem(MediaItemPtr mediaItem)
 {
+    // found by a scan which has been cancelled in the meantime
+    if (mediaItem->cancelled()) {
+        LOG_DEBUG(MEDIA_INDEXER_MEDIAINDEXER, "Drop cancelled media item '%s'", mediaItem->uri().c_str());
+        return;
+    }
+
     // this helps us for logging
     auto dev = mediaItem->device();
 
@@ -249,6 +255,8 @@ void MediaIndexer::newMediaItem(MediaItemPtr mediaItem)
         auto mdb = MediaDb::instance();
         //mdb->checkForChange(std::move(mediaItem));
         if (dev->isNewMountedDevice()) {
+            // listed right away, the meta data follows
+            mdb->putStatRow(*mediaItem);
             metaDataUpdateRequired(std::move(mediaItem));
         } else {
             if (mdb->needUpdate(mediaItem.get())) {
@@ -275,10 +283,22 @@ void MediaIndexer::newMediaItem(MediaItemPtr mediaItem)
 
 void MediaIndexer::removeMediaItem(MediaItemPtr mediaItem) 
 {
+    if (mediaItem->cancelled())
+        return;
     auto mdb = MediaDb::instance();
     mdb->requestDeleteItem(std::move(mediaItem));
 }
 
+void MediaIndexer::renameMediaItem(MediaItemPtr mediaItem, const std::string &oldUri)
+{
+    if (mediaItem->cancelled())
+        return;
+    LOG_INFO(MEDIA_INDEXER_MEDIAINDEXER, 0, "Media item '%s' has been moved to '%s'",
+        oldUri.c_str(), mediaItem->uri().c_str());
+    auto mdb = MediaDb::instance();
+    mdb->renameMediaItem(std::move(mediaItem), oldUri);
+}
+
 void MediaIndexer::metaDataUpdateRequired(MediaItemPtr mediaItem)
 {
     MediaParser::enqueueTask(std::move(mediaItem));
@@ -310,6 +330,12 @@ void MediaIndexer::flushDeleteItems(Device* device)
     mdb->flushDeleteItems(device);
 }
 
+void MediaIndexer::flushStatRows(Device* device)
+{
+    auto mdb = MediaDb::instance();
+    mdb->flushStatRows(device);
+}
+
 void MediaIndexer::notifyDeviceScanned()
 {
     indexerService_->notifyScanDone();
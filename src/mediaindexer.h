@@ -140,6 +140,9 @@ protected:
     /// MediaItemObserver interface.
     void flushDeleteItems(Device* device);
 
+    /// MediaItemObserver interface.
+    void flushStatRows(Device* device);
+
     /// MediaItemObserver interface.
     void notifyDeviceScanned();
 
@@ -149,6 +152,9 @@ protected:
     /// MediaItemObserver interface.
     void removeMediaItem(MediaItemPtr mediaItem);
 
+    /// MediaItemObserver interface.
+    void renameMediaItem(MediaItemPtr mediaItem, const std::string &oldUri);
+
 private:
     /// Singleton.
     MediaIndexer();
@@ -321,6 +321,7 @@ std::string MediaItem::metaToString(MediaItem::CommonType meta)
 MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
                      const std::string &mime, unsigned long hash, unsigned long filesize)
     : device_(device)
+    , generation_(device->scanGeneration())
     , type_(Type::EOL)
     , hash_(hash)
     , filesize_(filesize)
@@ -363,6 +364,7 @@ MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
                      const std::string &ext, const MediaItem::Type &type,
                      const MediaItem::ExtractorType &extType)
     : device_(device)
+    , generation_(device->scanGeneration())
     , type_(type)
     , hash_(hash)
     , filesize_(filesize)
@@ -391,6 +393,7 @@ MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
 MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
                      unsigned long hash, const MediaItem::Type &type)
     : device_(device)
+    , generation_(device->scanGeneration())
     , type_(type)
     , hash_(hash)
     , filesize_(0)
@@ -415,6 +418,7 @@ MediaItem::MediaItem(std::shared_ptr<Device> device, const std::string &path,
 
 MediaItem::MediaItem(const std::string &uri)
     : device_(Device::device(uri))
+    , generation_(device_ ? device_->scanGeneration() : 0)
     , type_(Type::EOL)
     , hash_(0)
     , filesize_(0)
@@ -494,6 +498,16 @@ unsigned long MediaItem::fileSize() const
     return filesize_;
 }
 
+void MediaItem::setModifiedTime(std::time_t mtime)
+{
+    modifiedTime_ = mtime;
+}
+
+std::time_t MediaItem::modifiedTime() const
+{
+    return modifiedTime_;
+}
+
 const std::string &MediaItem::path() const
 {
     return path_;
@@ -591,6 +605,11 @@ MediaItem::ExtractorType MediaItem::extractorType() const
     return extractorType_;
 }
 
+bool MediaItem::cancelled() const
+{
+    return device_ && device_->scanCancelled(generation_);
+}
+
 IMediaItemObserver *MediaItem::observer() const
 {
     return device_->observer();
@@ -693,3 +712,28 @@ void MediaItem::setThumbnailFileName(const std::string& name)
 {
     thumbnailFileName_ = name;
 }
+
+std::string MediaItem::fileTitle() const
+{
+    return std::filesystem::path(path_).stem().string();
+}
+
+bool MediaItem::thumbnailWanted() const
+{
+    return thumbnailWanted_;
+}
+
+void MediaItem::setThumbnailWanted(bool wanted)
+{
+    thumbnailWanted_ = wanted;
+}
+
+bool MediaItem::deferred() const
+{
+    return deferred_;
+}
+
+void MediaItem::setDeferred(bool deferred)
+{
+    deferred_ = deferred;
+}
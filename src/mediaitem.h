@@ -290,6 +290,22 @@ public:
      */
      unsigned long fileSize() const;
 
+    /**
+     * \brief Set the last modification time if it is already known
+     * from the file tree walk.
+     *
+     * \param[in] mtime Seconds since epoch.
+     */
+    void setModifiedTime(std::time_t mtime);
+
+    /**
+     * \brief Get the last modification time as set from the file
+     * tree walk.
+     *
+     * \return Seconds since epoch or 0 if not known.
+     */
+    std::time_t modifiedTime() const;
+
     /**
      * \brief Give the path as set from constructor.
      *
@@ -362,6 +378,14 @@ public:
      */
     bool parsed() const;
 
+    /**
+     * \brief Check if the scan this media item has been found by is
+     * outdated, e. g. because the device has gone in the meantime.
+     *
+     * \return True if the media item shall be dropped, else false.
+     */
+    bool cancelled() const;
+
     /**
      * \brief Get the media item uri.
      *
@@ -422,12 +446,49 @@ public:
      */
     void setThumbnailFileName(const std::string& name);
 
+    /**
+     * \brief Title derived from the file name, used when no meta
+     * data has been extracted.
+     *
+     * \return The file name without extension.
+     */
+    std::string fileTitle() const;
+
+    /**
+     * \brief Whether the extractors shall create a thumbnail.
+     *
+     * \return False if the thumbnail is deferred or skipped.
+     */
+    bool thumbnailWanted() const;
+
+    /**
+     * \brief Let the extractors create a thumbnail or not.
+     * \param[in] wanted The value to indicate thumbnail creation.
+     */
+    void setThumbnailWanted(bool wanted);
+
+    /**
+     * \brief Whether a part of the extraction has been left for the
+     * first meta data request.
+     *
+     * \return True if deferred.
+     */
+    bool deferred() const;
+
+    /**
+     * \brief Mark a part of the extraction as left for later.
+     * \param[in] deferred The value to indicate deferred extraction.
+     */
+    void setDeferred(bool deferred);
+
 private:
     /// Device mandatory for construction.
     MediaItem() : type_(Type::EOL), hash_(0), filesize_(0), parsed_(false), extractorType_(MediaItem::ExtractorType::EOL) {};
 
     /// Device this media item belongs to.
     std::shared_ptr<Device> device_;
+    /// Scan generation of the device at construction time.
+    unsigned long generation_ = 0;
     /// Type of media item.
     Type type_;
     /// Set of meta data available for this media item.
@@ -438,6 +499,8 @@ private:
     unsigned long hash_;
     /// filesize
     unsigned long filesize_;
+    /// Last modification time, 0 if unknown.
+    std::time_t modifiedTime_ = 0;
     /// If the media item has been parsed.
     bool parsed_;
     /// The media item uri.
@@ -455,6 +518,10 @@ private:
     /// The thumbnail file name
     std::string thumbnailFileName_;
     const int thumbnailFileNameLength_ = 15; 
+    /// If the extractors shall create a thumbnail.
+    bool thumbnailWanted_ = true;
+    /// If a part of the extraction has been left for later.
+    bool deferred_ = false;
 };
 
 /// Useful when iterating over enum.
@@ -19,10 +19,25 @@
 #include "plugins/plugin.h"
 #include "metadataextractors/imetadataextractor.h"
 #include "dbconnector/mediadb.h"
+#include "configurator.h"
+#include "metacache.h"
+#include "pipelinestage.h"
+#include "diskscheduler.h"
+#include "governor.h"
+#include "interesttracker.h"
+#include "extractionpolicy.h"
+#include <algorithm>
 #include <thread>
 #include <chrono>
 #include <condition_variable>
 
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 
 std::queue<std::unique_ptr<MediaParser>> MediaParser::tasks_;
 std::map<MediaItem::ExtractorType, std::shared_ptr<IMetaDataExtractor>> MediaParser::extractor_;
@@ -31,15 +46,73 @@ std::mutex MediaParser::lock_;
 std::unique_ptr<MediaParser> MediaParser::instance_;
 std::mutex MediaParser::ctorLock_;
 
+/**
+ * \brief Get the disk position of a file.
+ *
+ * Uses the physical offset of the first extent if the filesystem
+ * supports FIEMAP, else the inode number which follows the
+ * allocation order on most filesystems.
+ *
+ * \param[in] path The file path.
+ * \return Locality key, 0 if unknown.
+ */
+static unsigned long long localityKey(const std::string &path)
+{
+    if (path.empty() || path.front() != '/')
+        return 0;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+        return 0;
+
+    unsigned long long key = 0;
+    // room for the first extent only
+    alignas(struct fiemap) char buf[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+    auto map = reinterpret_cast<struct fiemap *>(buf);
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0 &&
+        !(map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN)) {
+        key = map->fm_extents[0].fe_physical;
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+            key = st.st_ino;
+    }
+    close(fd);
+    return key;
+}
 
-void MediaParser::enqueueTask(MediaItemPtr mediaItem)
+void MediaParser::enqueueTask(MediaItemPtr mediaItem, bool urgent)
 {
-    auto type = mediaItem->extractorType();
     MediaParser* mParser = MediaParser::instance();
+    // the walk must not run ahead of the extraction, this is what
+    // keeps the number of live media items bounded
+    PipelineStage::get(PipelineStage::Id::Extract).enter();
+    // only pay for the disk position lookup if we reorder at all
+    unsigned long long key = 0;
+    if (mParser->localityWindow_ > 1)
+        key = localityKey(mediaItem->path());
+    auto lane = laneOf(*mediaItem);
+    auto device = mediaItem->device();
+    std::string disk = device ? device->disk() : "";
+    // a client is looking at it, extract it before the rest
+    bool interest = urgent || InterestTracker::instance()->matches(mediaItem->uri());
     std::lock_guard<std::mutex> lock(mParser->mediaItemLock_);
-    mParser->mediaItemQueue_.push(std::move(mediaItem));
+    auto &laneRef = mParser->lanes_[lane];
+    auto &diskRef = laneRef.disks[disk];
+    if (interest) {
+        diskRef.queue.emplace(diskRef.queue.begin() + diskRef.promoted, key, std::move(mediaItem));
+        diskRef.promoted++;
+        laneRef.promoted++;
+    } else {
+        diskRef.queue.emplace_back(key, std::move(mediaItem));
+    }
+    laneRef.queued++;
+    // a worker picks whatever is most urgent, not necessarily this
+    // media item
     GError *error = nullptr;
-    if (!g_thread_pool_push(mParser->pool, static_cast<void*>(&type), &error)) {
+    if (!g_thread_pool_push(mParser->pool, mParser, &error)) {
         LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "Fail occurred in g_thread_pool_push");
         if (error) {
             LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "Error Message : %s", error->message);
@@ -48,6 +121,14 @@ void MediaParser::enqueueTask(MediaItemPtr mediaItem)
     }
 }
 
+size_t MediaParser::laneOf(const MediaItem &mediaItem)
+{
+    const auto &path = mediaItem.path();
+    if (path.empty() || path.front() != '/')
+        return static_cast<size_t>(MediaItem::ExtractorType::EOL);
+    return static_cast<size_t>(mediaItem.extractorType());
+}
+
 MediaParser *MediaParser::instance()
 {
     std::lock_guard<std::mutex> lk(ctorLock_);
@@ -66,10 +147,51 @@ MediaParser::~MediaParser()
     //mediaItem_.reset();
 }
 
-MediaParser::MediaParser()
+MediaParser::MediaParser() :
+    localityWindow_(0),
+    workers_(PARALLEL_META_EXTRACTION),
+    activeWorkers_(0)
 {
-    pool = g_thread_pool_new((GFunc) &MediaParser::extractMeta, this, PARALLEL_META_EXTRACTION, TRUE, NULL);
-    g_thread_pool_set_max_unused_threads(PARALLEL_META_EXTRACTION);
+    auto window = Configurator::instance()->getExtractionLocalityWindow();
+    if (window > 1)
+        localityWindow_ = static_cast<size_t>(window);
+    auto metaCacheSize = Configurator::instance()->getMetaCacheSize();
+    if (metaCacheSize > 0)
+        MetaCache::instance()->setCapacity(static_cast<size_t>(metaCacheSize));
+    auto queueSize = Configurator::instance()->getExtractionQueueSize();
+    if (queueSize > 0)
+        PipelineStage::get(PipelineStage::Id::Extract).setCapacity(static_cast<size_t>(queueSize));
+
+    // configured lanes first, the others are unlimited and least
+    // urgent
+    std::array<bool, std::tuple_size<decltype(lanes_)>::value> ordered = {};
+    for (const auto &config : Configurator::instance()->getExtractionLanes()) {
+        auto lane = static_cast<size_t>(config.extractor);
+        if (ordered[lane])
+            continue;
+        ordered[lane] = true;
+        lanes_[lane].limit = config.workers > 0 ? static_cast<size_t>(config.workers) : 0;
+        laneOrder_.push_back(lane);
+    }
+    for (size_t lane = 0; lane < lanes_.size(); ++lane) {
+        if (!ordered[lane])
+            laneOrder_.push_back(lane);
+    }
+
+    // the build default is the upper limit in adaptive mode
+    auto threads = Configurator::instance()->getExtractionThreads();
+    if (threads > 0)
+        workers_ = static_cast<size_t>(threads);
+    auto maxWorkers = workers_;
+    if (Configurator::instance()->getAdaptiveExtractionThreads()) {
+        sizer_.reset(new PoolSizer(1, maxWorkers));
+        workers_ = sizer_->initial();
+    }
+    LOG_INFO(MEDIA_INDEXER_MEDIAPARSER, 0, "Meta data extraction with %zu threads%s", workers_,
+        sizer_ ? " (adaptive)" : "");
+
+    pool = g_thread_pool_new((GFunc) &MediaParser::extractMeta, this, static_cast<gint>(workers_), TRUE, NULL);
+    g_thread_pool_set_max_unused_threads(static_cast<gint>(maxWorkers));
 
     // create each extractors
     for (auto type = MediaItem::ExtractorType::TagLibExtractor;
@@ -115,6 +237,10 @@ bool MediaParser::setMediaItem(std::string & uri)
 
 bool MediaParser::extractExtraMeta(pbnjson::JValue &meta)
 {
+    // the scan has left part of the extraction for the first use, the
+    // reply shows the row as it is and the rest follows in the
+    // background
+    MediaItemPtr pending;
     try {
         std::lock_guard<std::mutex> lock(mediaItemLock_);
         auto mi = mediaItem_.get();
@@ -125,19 +251,22 @@ bool MediaParser::extractExtraMeta(pbnjson::JValue &meta)
         LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "Media item to extract %p with parser %p", mi, this);
         auto path = mediaItem_->path();
 
+        if (meta.hasKey("deferred") && meta["deferred"].asBool()) {
+            pending = std::make_unique<MediaItem>(mi->uri());
+            pending->setExtractorType(getType(pending->type(), pending->ext()));
+            pending->setDeferred(true);
+        }
+
         if (!path.empty() && path.front() == '/') {
             MediaItem::ExtractorType p = getType(mediaItem_->type(), mi->ext());
 
-            if (extractor_.find(p) != extractor_.end()) {
-                extractor_[p]->extractMeta(*mi, true);
-                mi->setParsed(true);
-            } else {
+            if (extractor_.find(p) == extractor_.end()) {
                 LOG_WARNING(MEDIA_INDEXER_MEDIAPARSER, 0, "Could not found valid extractor, type : %s, ext : %s", MediaItem::mediaTypeToString(mediaItem_->type()).c_str(), mi->ext().c_str());
                 LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "Create new extractor");
                 extractor_[p] = IMetaDataExtractor::extractor(p);
-                extractor_[p]->extractMeta(*mi, true);
-                mi->setParsed(true);
             }
+            extractor_[p]->extractMeta(*mi, true);
+            mi->setParsed(true);
         } else {
             auto plg = PluginFactory().plugin(mediaItem_->uri());
             plg->extractMeta(*mi, true);
@@ -155,34 +284,264 @@ bool MediaParser::extractExtraMeta(pbnjson::JValue &meta)
         LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "MediaParser::extractMeta failure by unexpected failure");
         return false;
     }
+    // the lanes share the lock, queue it once released
+    if (pending && pending->type() != MediaItem::Type::EOL)
+        enqueueTask(std::move(pending), true);
     return true;
 }
 
-void MediaParser::extractMeta(void *data, void *user_data)
+MediaItemPtr MediaParser::pickMediaItem(size_t &lane, std::string &disk)
 {
-    // make sure we are deleted when this method terminates
-    try {
-        if (!data || !user_data) {
-            LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "Invalid Input parameters");
-            return;
+    // items of interest first, then the rest
+    for (bool urgent : { true, false }) {
+        for (auto idx : laneOrder_) {
+            auto &candidate = lanes_[idx];
+            if (!(urgent ? candidate.promoted : candidate.queued) ||
+                (candidate.limit && candidate.running >= candidate.limit))
+                continue;
+
+            // round robin over the disks, starting after the last one
+            auto iter = candidate.disks.end();
+            auto next = candidate.disks.upper_bound(candidate.lastDisk);
+            for (size_t count = 0; count < candidate.disks.size(); ++count, ++next) {
+                if (next == candidate.disks.end())
+                    next = candidate.disks.begin();
+                if (!(urgent ? next->second.promoted : next->second.queue.size()) ||
+                    !diskAvailable(next->first))
+                    continue;
+                iter = next;
+                break;
+            }
+            if (iter == candidate.disks.end())
+                continue;
+
+            lane = idx;
+            disk = iter->first;
+            candidate.lastDisk = disk;
+            candidate.running++;
+            candidate.queued--;
+            if (iter->second.promoted)
+                candidate.promoted--;
+            diskRunning_[disk].first++;
+            return nextMediaItem(iter->second);
+        }
+    }
+    return nullptr;
+}
+
+void MediaParser::promote()
+{
+    auto tracker = InterestTracker::instance();
+    std::lock_guard<std::mutex> lock(mediaItemLock_);
+    for (auto &lane : lanes_) {
+        for (auto &entry : lane.disks) {
+            auto &disk = entry.second;
+            auto begin = disk.queue.begin() + disk.promoted;
+            auto end = std::stable_partition(begin, disk.queue.end(), [tracker] (const auto &item) {
+                return tracker->matches(item.second->uri());
+            });
+            auto count = static_cast<size_t>(end - begin);
+            disk.promoted += count;
+            lane.promoted += count;
+        }
+    }
+}
+
+bool MediaParser::diskAvailable(const std::string &disk)
+{
+    auto iter = diskRunning_.find(disk);
+    if (iter == diskRunning_.end()) {
+        // the limit only depends on the disk, look it up once
+        auto limit = DiskScheduler::instance()->extractionLimit(disk);
+        iter = diskRunning_.emplace(disk, std::make_pair(0, limit)).first;
+    }
+    return !iter->second.second || iter->second.first < iter->second.second;
+}
+
+MediaItemPtr MediaParser::nextMediaItem(DiskQueue &disk)
+{
+    auto &queue = disk.queue;
+    auto pick = queue.begin();
+    if (disk.promoted) {
+        // a client waits for it, no reordering by locality
+        disk.promoted--;
+        MediaItemPtr mip = std::move(pick->second);
+        queue.erase(pick);
+        return mip;
+    }
+    if (localityWindow_ > 1 && disk.frontSkips < localityWindow_) {
+        // one way elevator over the window: take the closest item at
+        // or behind the last position, wrap around to the lowest
+        // one if there is none. Only items of the same device are
+        // comparable.
+        auto dev = pick->second->device();
+        auto end = queue.size() > localityWindow_ ? queue.begin() + localityWindow_ : queue.end();
+        auto ahead = queue.end();
+        for (auto iter = queue.begin(); iter != end; ++iter) {
+            if (iter->second->device() != dev)
+                continue;
+            if (iter->first >= disk.localityHead &&
+                (ahead == queue.end() || iter->first < ahead->first))
+                ahead = iter;
+            if (iter->first < pick->first)
+                pick = iter;
         }
-        MediaParser *mp = static_cast<MediaParser *>(user_data);
+        if (ahead != queue.end())
+            pick = ahead;
+    }
+
+    // the front must not wait forever behind better placed items
+    if (pick == queue.begin())
+        disk.frontSkips = 0;
+    else
+        disk.frontSkips++;
+
+    disk.localityHead = pick->first;
+    MediaItemPtr mip = std::move(pick->second);
+    queue.erase(pick);
+    return mip;
+}
+
+bool MediaParser::idle() const
+{
+    for (const auto &lane : lanes_) {
+        if (lane.queued)
+            return false;
+    }
+    return true;
+}
+
+void MediaParser::extractMeta(void *data, void *user_data)
+{
+    if (!data || !user_data) {
+        LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "Invalid Input parameters");
+        return;
+    }
+    MediaParser *mp = static_cast<MediaParser *>(user_data);
+    {
+        std::lock_guard<std::mutex> lock(mp->mediaItemLock_);
+        mp->activeWorkers_++;
+    }
+
+    // keep going while there is something this worker may take, a
+    // lane at its limit is served by its own workers once they are
+    // done
+    for (;;) {
+        // held back at boot and during playback
+        auto governor = Governor::instance();
+        governor->acquire(Governor::Stage::Extract);
 
         MediaItemPtr mip;
+        size_t lane;
+        std::string disk;
         {
-            // mediaItemQueue is resource that task threads use it.
+            // the lanes are shared by all workers, a worker only
+            // leaves for a shrunk pool while another one is left to
+            // serve the lanes
             std::lock_guard<std::mutex> lock(mp->mediaItemLock_);
-            mip = std::move(mp->mediaItemQueue_.front());
-            mp->mediaItemQueue_.pop();
+            if (mp->activeWorkers_ <= mp->workers_)
+                mip = mp->pickMediaItem(lane, disk);
+            if (!mip) {
+                mp->activeWorkers_--;
+                governor->release(Governor::Stage::Extract);
+                return;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        extract(mp, std::move(mip));
+        governor->release(Governor::Stage::Extract);
+
+        // write the meta cache once the queues have run dry
+        bool idle;
+        size_t workers;
+        {
+            std::lock_guard<std::mutex> lock(mp->mediaItemLock_);
+            mp->lanes_[lane].running--;
+            mp->diskRunning_[disk].first--;
+            idle = mp->idle();
+            workers = mp->workers_;
+        }
+        if (idle)
+            MetaCache::instance()->save();
+
+        if (mp->sizer_) {
+            mp->sizer_->itemDone(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start));
+            // more workers do not help while the governor holds
+            // them back
+            auto next = mp->sizer_->update(workers, !idle && !governor->limited());
+            if (next != workers)
+                mp->setWorkers(next);
         }
+    }
+}
+
+void MediaParser::setWorkers(size_t workers)
+{
+    {
+        std::lock_guard<std::mutex> lock(mediaItemLock_);
+        workers_ = workers;
+    }
+    // queued pool tasks start the new threads when growing, surplus
+    // workers leave after their current item when shrinking
+    GError *error = nullptr;
+    if (!g_thread_pool_set_max_threads(pool, static_cast<gint>(workers), &error)) {
+        LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "Fail occurred in g_thread_pool_set_max_threads");
+        if (error) {
+            LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "Error Message : %s", error->message);
+            g_error_free(error);
+        }
+    }
+}
 
+void MediaParser::extract(MediaParser *mp, MediaItemPtr mip)
+{
+    // entered in enqueueTask(), left once the item has been handed
+    // to the persist stage or dropped
+    PipelineStage::Scope stage(PipelineStage::Id::Extract, std::adopt_lock);
+    try {
         LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "Media item to extract %p with parser %p", mip.get(), mp);
 
+        // the device has gone or is being rescanned, the item is stale
+        if (mip->cancelled()) {
+            LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "Drop cancelled media item %s", mip->uri().c_str());
+            return;
+        }
+
+        // a deferred extraction which has been asked for
+        bool complete = mip->deferred();
         auto path = mip->path();
         if (!path.empty() && path.front() == '/') {
             MediaItem::ExtractorType p = mip->extractorType();
-            if (!extractor_[p]->extractMeta(*mip)) {
-                LOG_WARNING(MEDIA_INDEXER_MEDIAPARSER, 0, "%s meta data extraction failed!", mip->uri().c_str());
+            // the same content may have been extracted on another
+            // device or under another path already
+            auto metaCache = MetaCache::instance();
+            std::string key;
+            if (metaCache->enabled())
+                key = MetaCache::fingerprint(path);
+            if (metaCache->restore(key, *mip)) {
+                extractor_[p]->setMetaCommon(*mip);
+            } else {
+                // huge files may get only part of the extraction now,
+                // a client asking for one completes it in full
+                ExtractionPolicy::Decision decision;
+                if (!complete)
+                    decision = ExtractionPolicy::instance()->decide(*mip);
+                mip->setThumbnailWanted(decision.thumbnail == ExtractionPolicy::Action::Now);
+                mip->setDeferred(decision.meta == ExtractionPolicy::Action::Defer ||
+                    decision.thumbnail == ExtractionPolicy::Action::Defer);
+                if (decision.meta != ExtractionPolicy::Action::Now) {
+                    LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "Meta data extraction for %s %s",
+                        mip->uri().c_str(), mip->deferred() ? "deferred" : "skipped");
+                    mip->setMeta(MediaItem::Meta::Title, mip->fileTitle());
+                    extractor_[p]->setMetaCommon(*mip);
+                } else if (!extractor_[p]->extractMeta(*mip)) {
+                    LOG_WARNING(MEDIA_INDEXER_MEDIAPARSER, 0, "%s meta data extraction failed!", mip->uri().c_str());
+                } else if (decision.thumbnail == ExtractionPolicy::Action::Now) {
+                    // only complete results are shared
+                    metaCache->store(key, *mip);
+                }
             }
         } else {
             auto plg = PluginFactory().plugin(mip->uri());
@@ -190,11 +549,15 @@ void MediaParser::extractMeta(void *data, void *user_data)
         }
 
         mip->setParsed(true);
+        if (complete) {
+            mip->setDeferred(false);
+            MediaDb::instance()->completeDeferred(*mip);
+            return;
+        }
         LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "Pushing parsed mediaitem %p to mdb, updateMediaItem start", mip.get());
         auto mdb = MediaDb::instance();
         mdb->updateMediaItem(std::move(mip));
         LOG_DEBUG(MEDIA_INDEXER_MEDIAPARSER, "mdb->updateMediaItem Done");
-
     } catch (const std::exception & e) {
         LOG_ERROR(MEDIA_INDEXER_MEDIAPARSER, 0, "MediaParser::extractMeta failure: %s", e.what());
     } catch (...) {
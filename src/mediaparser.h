@@ -16,25 +16,35 @@
 
 #pragma once
 
-#include "task.h"
 #include "mediaitem.h"
 #include "metadataextractors/imetadataextractor.h"
+#include "poolsizer.h"
 #include <pbnjson.hpp>
 
+#include <array>
 #include <thread>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <deque>
 #include <list>
+#include <map>
+#include <string>
 #include <atomic>
+#include <vector>
 #include <glib.h>
 
 /// Media parser class for meta data extraction.
 class MediaParser
 {
  public:
-    /// Enqueue meta data extraction task.
-    static void enqueueTask(MediaItemPtr mediaItem);
+    /**
+     * \brief Enqueue meta data extraction task.
+     *
+     * \param[in] mediaItem The media item to extract.
+     * \param[in] urgent Queue it with the media items of interest.
+     */
+    static void enqueueTask(MediaItemPtr mediaItem, bool urgent = false);
 
     static void extractMeta(void *data, void *user_data);
 
@@ -54,6 +64,9 @@ class MediaParser
 
     /// For the purpose of direct meta extraction from indexer service api
     bool extractExtraMeta(pbnjson::JValue &meta);
+
+    /// Move the queued media items of interest to the queue fronts.
+    void promote();
     virtual ~MediaParser();
 
  private:
@@ -80,7 +93,78 @@ class MediaParser
     /// Set if the default extractor shall be used.
     bool useDefaultExtractor_;
 
-    /// The media item queue
-    /// This media item queue will use task thread
-    std::queue<MediaItemPtr> mediaItemQueue_;
+    /// Queued media items of one physical disk within a lane.
+    struct DiskQueue {
+        /// The media item queue with the disk locality key of each item
+        std::deque<std::pair<unsigned long long, MediaItemPtr>> queue;
+        /// Locality key of the last picked item.
+        unsigned long long localityHead = 0;
+        /// How often the queue front has been passed over.
+        size_t frontSkips = 0;
+        /// Number of items of interest at the queue front.
+        size_t promoted = 0;
+    };
+
+    /// Extraction lane, one per extractor type and one for media
+    /// items extracted by their plugin.
+    struct Lane {
+        /// Queues by physical disk, served round robin so one big
+        /// disk does not starve the others.
+        std::map<std::string, DiskQueue> disks;
+        /// The disk served last.
+        std::string lastDisk;
+        /// Number of queued items over all disks.
+        size_t queued = 0;
+        /// Number of queued items of interest over all disks.
+        size_t promoted = 0;
+        /// Maximum number of concurrent extractions, 0 is unlimited.
+        size_t limit = 0;
+        /// Number of running extractions.
+        size_t running = 0;
+    };
+
+    /// Get the lane of a media item.
+    static size_t laneOf(const MediaItem &mediaItem);
+
+    /// Extract one media item and hand it to the database.
+    static void extract(MediaParser *mp, MediaItemPtr mip);
+
+    /// Pick the next media item from the most urgent lane which is
+    /// below its limit and the next disk of that lane which is below
+    /// its limit, must be called with mediaItemLock_ locked.
+    MediaItemPtr pickMediaItem(size_t &lane, std::string &disk);
+
+    /// Pick the next queued media item of a disk, items of interest
+    /// first, must be called with mediaItemLock_ locked.
+    MediaItemPtr nextMediaItem(DiskQueue &disk);
+
+    /// Check whether a disk takes another extraction, must be called
+    /// with mediaItemLock_ locked.
+    bool diskAvailable(const std::string &disk);
+
+    /// Nothing queued in any lane, must be called with mediaItemLock_
+    /// locked.
+    bool idle() const;
+
+    /// Change the number of extraction workers.
+    void setWorkers(size_t workers);
+
+    /// Lanes indexed by extractor type, the last one takes the media
+    /// items extracted by their plugin.
+    std::array<Lane, static_cast<size_t>(MediaItem::ExtractorType::EOL) + 1> lanes_;
+    /// Lane indices, most urgent first. Free workers go to the first
+    /// lane with queued items which is below its limit.
+    std::vector<size_t> laneOrder_;
+    /// Number of queued items to choose from by locality, 0 or 1
+    /// keeps the queue order.
+    size_t localityWindow_;
+    /// Running extractions and their limit per physical disk.
+    std::map<std::string, std::pair<size_t, size_t>> diskRunning_;
+    /// Wanted and running number of workers, a worker leaves once
+    /// there are more running than wanted. Protected by
+    /// mediaItemLock_.
+    size_t workers_;
+    size_t activeWorkers_;
+    /// Sizes the worker pool at runtime, only in adaptive mode.
+    std::unique_ptr<PoolSizer> sizer_;
 };
@@ -155,7 +155,8 @@ bool GStreamerExtractor::extractMeta(MediaItem &mediaItem, bool extra) const
         if (!extra) {
             setMeta(mediaItem, discoverInfo, GST_TAG_TITLE);
             setMeta(mediaItem, discoverInfo, GST_TAG_DURATION);
-            setMeta(mediaItem, discoverInfo, GST_TAG_THUMBNAIL);
+            if (mediaItem.thumbnailWanted())
+                setMeta(mediaItem, discoverInfo, GST_TAG_THUMBNAIL);
         } else {
             setMeta(mediaItem, discoverInfo, GST_TAG_DATE_TIME);
             setMeta(mediaItem, discoverInfo, GST_TAG_VIDEO_CODEC);
@@ -101,13 +101,17 @@ std::string IMetaDataExtractor::lastModifiedDate(MediaItem &mediaItem, bool loca
         return "";
     }
 
-    struct stat fStatus;
-    if (stat(path.c_str(), &fStatus) < 0) {
-        LOG_ERROR(MEDIA_INDEXER_IMETADATAEXTRACTOR, 0, "stat error, caused by : %s", strerror(errno));
-        return "";
+    // the file tree walk usually knows the time already
+    std::time_t timeFormatted = mediaItem.modifiedTime();
+    if (!timeFormatted) {
+        struct stat fStatus;
+        if (stat(path.c_str(), &fStatus) < 0) {
+            LOG_ERROR(MEDIA_INDEXER_IMETADATAEXTRACTOR, 0, "stat error, caused by : %s", strerror(errno));
+            return "";
+        }
+        timeFormatted = fStatus.st_mtime;
     }
     std::stringstream ss;
-    std::time_t timeFormatted = fStatus.st_mtime;
     if (localTime)
     {
         ss << std::put_time(std::localtime(&timeFormatted), "%c %Z");
@@ -205,7 +205,8 @@ bool TaglibExtractor::setMetaFromTag(MediaItem &mediaItem, TagLib::Tag *tag, Fil
                 setMetaMp3(mediaItem, t, nullptr, MediaItem::Meta::Genre);
                 setMetaMp3(mediaItem, t, nullptr, MediaItem::Meta::Album);
                 setMetaMp3(mediaItem, t, nullptr, MediaItem::Meta::Artist);
-                setMetaMp3(mediaItem, t, nullptr, MediaItem::Meta::Thumbnail);
+                if (mediaItem.thumbnailWanted())
+                    setMetaMp3(mediaItem, t, nullptr, MediaItem::Meta::Thumbnail);
             } else {
                 setMetaMp3(mediaItem, t, nullptr, MediaItem::Meta::DateOfCreation);
                 setMetaMp3(mediaItem, t, nullptr, MediaItem::Meta::AlbumArtist);
@@ -0,0 +1,143 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "pipelinestage.h"
+
+#include <chrono>
+#include <cinttypes>
+
+#include <glib.h>
+
+PipelineStage::Scope::Scope(Id id) :
+    id_(id)
+{
+    PipelineStage::get(id_).enter();
+}
+
+PipelineStage::Scope::Scope(Id id, std::adopt_lock_t) :
+    id_(id)
+{
+    // nothing to be done here
+}
+
+PipelineStage::Scope::~Scope()
+{
+    PipelineStage::get(id_).leave();
+}
+
+PipelineStage &PipelineStage::get(Id id)
+{
+    static PipelineStage stages[static_cast<int>(Id::EOL)];
+    return stages[static_cast<int>(id)];
+}
+
+const char *PipelineStage::name(Id id)
+{
+    switch (id) {
+    case Id::Scan:
+        return "scan";
+    case Id::Extract:
+        return "extract";
+    case Id::Persist:
+        return "persist";
+    default:
+        return "unknown";
+    }
+}
+
+void PipelineStage::logStats()
+{
+    for (int idx = 0; idx < static_cast<int>(Id::EOL); ++idx) {
+        auto id = static_cast<Id>(idx);
+        auto stats = get(id).stats();
+        LOG_INFO(MEDIA_INDEXER_PIPELINE, 0, "Stage %s: depth %zu, peak %zu, in %" PRIu64
+            ", out %" PRIu64 ", stalls %" PRIu64 " (%" PRIu64 " ms)", name(id), stats.depth,
+            stats.peak, stats.entered, stats.left, stats.stalls, stats.stallMs);
+    }
+}
+
+PipelineStage::PipelineStage() :
+    capacity_(0),
+    depth_(0),
+    peak_(0),
+    entered_(0),
+    left_(0),
+    stalls_(0),
+    stallMs_(0),
+    waiters_(0)
+{
+    // nothing to be done here
+}
+
+void PipelineStage::setCapacity(size_t capacity)
+{
+    capacity_ = capacity;
+    std::lock_guard<std::mutex> lock(lock_);
+    cond_.notify_all();
+}
+
+void PipelineStage::enter()
+{
+    auto depth = depth_.load();
+    for (;;) {
+        auto capacity = capacity_.load();
+        if (capacity && depth >= capacity && mayBlock()) {
+            // full, wait for a consumer
+            auto start = std::chrono::steady_clock::now();
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                waiters_++;
+                cond_.wait(lock, [this] () {
+                    auto capacity = capacity_.load();
+                    return !capacity || depth_ < capacity;
+                });
+                waiters_--;
+            }
+            stalls_++;
+            stallMs_ += std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            depth = depth_.load();
+            continue;
+        }
+        if (depth_.compare_exchange_weak(depth, depth + 1))
+            break;
+    }
+
+    entered_++;
+    auto peak = peak_.load();
+    while (depth + 1 > peak && !peak_.compare_exchange_weak(peak, depth + 1));
+}
+
+void PipelineStage::leave()
+{
+    depth_--;
+    left_++;
+    if (waiters_ > 0) {
+        std::lock_guard<std::mutex> lock(lock_);
+        cond_.notify_one();
+    }
+}
+
+PipelineStage::Stats PipelineStage::stats() const
+{
+    return { depth_.load(), peak_.load(), entered_.load(), left_.load(),
+        stalls_.load(), stallMs_.load() };
+}
+
+bool PipelineStage::mayBlock()
+{
+    return !g_main_context_is_owner(g_main_context_default());
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * \brief Bounded stage of the indexing pipeline.
+ *
+ * Media items pass the stages walk, classify, diff, extract and
+ * persist. The first three run synchronously in the file tree walker
+ * workers, so at most one item per worker is in there. Extraction and
+ * persisting are asynchronous and used to take every item the walk
+ * found, a big device kept most of its media items alive at once.
+ *
+ * A stage counts the items it holds. enter() blocks while the stage
+ * is full, so an upstream stage can not run further ahead than the
+ * capacity of its downstream stage and the number of live media
+ * items stays flat regardless of the device size. The fast path is a
+ * single compare and swap, the lock is only taken to sleep and to
+ * wake up a blocked producer.
+ *
+ * The thread running the default main context never blocks, the
+ * luna replies which drain the persist stage are dispatched there.
+ */
+class PipelineStage
+{
+public:
+    /// The stages, in pipeline order.
+    enum class Id {
+        Scan,    ///< Walk, classify and diff of one file.
+        Extract, ///< Queued for or in meta data extraction.
+        Persist, ///< Sent to the database, waiting for the reply.
+        EOL
+    };
+
+    /// Stage statistics.
+    struct Stats {
+        /// Items in the stage now.
+        size_t depth;
+        /// Maximum depth seen.
+        size_t peak;
+        /// Items which have entered and left the stage.
+        uint64_t entered;
+        uint64_t left;
+        /// Producers which had to wait and their total wait time.
+        uint64_t stalls;
+        uint64_t stallMs;
+    };
+
+    /// Leaves the stage on destruction.
+    class Scope
+    {
+    public:
+        explicit Scope(Id id);
+        /// Take over an item which has entered the stage before.
+        Scope(Id id, std::adopt_lock_t);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Id id_;
+    };
+
+    /**
+     * \brief Get a stage.
+     *
+     * \param[in] id The stage id.
+     * \return The stage object.
+     */
+    static PipelineStage &get(Id id);
+
+    /// Stage name for logging.
+    static const char *name(Id id);
+
+    /// Log the statistics of all stages.
+    static void logStats();
+
+    /**
+     * \brief Set the number of items the stage takes.
+     *
+     * \param[in] capacity Maximum depth, 0 is unbounded.
+     */
+    void setCapacity(size_t capacity);
+
+    /// Take one item, blocks while the stage is full.
+    void enter();
+
+    /// Release one item.
+    void leave();
+
+    /// Get the current statistics.
+    Stats stats() const;
+
+private:
+    PipelineStage();
+
+    /// Whether the calling thread may wait for downstream stages.
+    static bool mayBlock();
+
+    std::atomic<size_t> capacity_;
+    std::atomic<size_t> depth_;
+    std::atomic<size_t> peak_;
+    std::atomic<uint64_t> entered_;
+    std::atomic<uint64_t> left_;
+    std::atomic<uint64_t> stalls_;
+    std::atomic<uint64_t> stallMs_;
+    /// Producers sleeping in enter().
+    std::atomic<size_t> waiters_;
+    std::mutex lock_;
+    std::condition_variable cond_;
+};
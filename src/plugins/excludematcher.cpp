@@ -0,0 +1,111 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "excludematcher.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include <fnmatch.h>
+
+ExcludeMatcher::ExcludeMatcher(const ExcludeConfig &config) :
+    hidden_(config.hidden),
+    maxDepth_(config.maxDepth > 0 ? config.maxDepth : 0),
+    skipMarker_(config.nomedia ? ".nomedia" : "")
+{
+    for (const auto &name : config.directories)
+        names_.insert(toLower(name));
+
+    for (auto pattern : config.patterns) {
+        while (!pattern.empty() && pattern.back() == '/')
+            pattern.pop_back();
+        while (!pattern.empty() && pattern.front() == '/')
+            pattern.erase(0, 1);
+        if (pattern.empty())
+            continue;
+
+        if (pattern.find_first_of("*?[") == std::string::npos)
+            paths_.insert(toLower(pattern));
+        else
+            patterns_.push_back(std::move(pattern));
+    }
+
+    LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Exclude matcher: %zu names, %zu paths, %zu patterns, depth %d",
+        names_.size(), paths_.size(), patterns_.size(), maxDepth_);
+}
+
+ExcludeMatcher::~ExcludeMatcher()
+{
+    // nothing to be done here
+}
+
+bool ExcludeMatcher::excludeDirectory(const std::string &root, const std::string &dir) const
+{
+    // the mountpoint itself is never excluded
+    size_t start = root.size();
+    while (start > 0 && root[start - 1] == '/')
+        --start;
+    if (dir.size() <= start || dir.compare(0, start, root, 0, start) || dir[start] != '/')
+        return false;
+    while (start < dir.size() && dir[start] == '/')
+        ++start;
+    if (start >= dir.size())
+        return false;
+
+    std::string rel = dir.substr(start);
+    auto pos = rel.find_last_of('/');
+    std::string name = pos == std::string::npos ? rel : rel.substr(pos + 1);
+
+    if (hidden_ && !name.empty() && name.front() == '.')
+        return true;
+
+    if (maxDepth_ > 0 && std::count(rel.begin(), rel.end(), '/') + 1 > maxDepth_)
+        return true;
+
+    if (!names_.empty() && names_.find(toLower(name)) != names_.end())
+        return true;
+
+    if (!paths_.empty() && paths_.find(toLower(rel)) != paths_.end())
+        return true;
+
+    for (const auto &pattern : patterns_) {
+        if (!fnmatch(pattern.c_str(), rel.c_str(), FNM_PATHNAME | FNM_PERIOD | FNM_CASEFOLD))
+            return true;
+    }
+
+    return false;
+}
+
+bool ExcludeMatcher::excludeFile(const std::string &path) const
+{
+    if (!hidden_)
+        return false;
+    auto pos = path.find_last_of('/');
+    return path[pos == std::string::npos ? 0 : pos + 1] == '.';
+}
+
+const std::string &ExcludeMatcher::skipMarker() const
+{
+    return skipMarker_;
+}
+
+std::string ExcludeMatcher::toLower(const std::string &str)
+{
+    std::string lower(str);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+        [] (unsigned char c) { return std::tolower(c); });
+    return lower;
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "configurator.h"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * \brief Decides which directories and files are left out of the
+ * file tree walk.
+ *
+ * The exclude configuration is compiled once: directory names and
+ * patterns without wildcards go to hash sets, only real glob
+ * patterns are matched with fnmatch(). Directories are checked
+ * before they are read so an excluded subtree is never enumerated.
+ */
+class ExcludeMatcher
+{
+public:
+    /**
+     * \brief Compile matcher.
+     *
+     * \param[in] config The exclude configuration.
+     */
+    ExcludeMatcher(const ExcludeConfig &config);
+    virtual ~ExcludeMatcher();
+
+    /**
+     * \brief Check if a directory shall be pruned.
+     *
+     * \param[in] root The device mountpoint.
+     * \param[in] dir The directory below root.
+     * \return True if dir and everything below shall be skipped.
+     */
+    bool excludeDirectory(const std::string &root, const std::string &dir) const;
+
+    /**
+     * \brief Check if a file shall be skipped by its name.
+     *
+     * \param[in] path The file path.
+     * \return True if the file shall be skipped.
+     */
+    bool excludeFile(const std::string &path) const;
+
+    /**
+     * \brief Get the name of the file which excludes its directory.
+     *
+     * \return The marker file name or an empty string.
+     */
+    const std::string &skipMarker() const;
+
+private:
+    /// Lower case copy of str.
+    static std::string toLower(const std::string &str);
+
+    /// Skip hidden files and directories.
+    bool hidden_;
+    /// Maximum depth, 0 is unlimited.
+    int maxDepth_;
+    /// Marker file name, e. g. '.nomedia'.
+    std::string skipMarker_;
+    /// Lower case directory names.
+    std::unordered_set<std::string> names_;
+    /// Lower case relative paths without wildcards.
+    std::unordered_set<std::string> paths_;
+    /// Glob patterns.
+    std::vector<std::string> patterns_;
+};
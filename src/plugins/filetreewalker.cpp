@@ -0,0 +1,583 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "filetreewalker.h"
+#include "governor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+/// Upper limit for the default worker count, the walk is mostly
+/// bound by the device queue depth and not by the cpu.
+#define WALKER_DEFAULT_MAX_WORKERS 4
+
+/// Buffer size for one getdents64 call, big enough for several
+/// hundred entries on typical media folders.
+#define WALKER_GETDENTS_BUFFER_SIZE (32 * 1024)
+
+namespace {
+
+/// Kernel directory entry as returned from getdents64.
+struct LinuxDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/// The file attributes the walker needs.
+struct FileStat {
+    bool isDir;
+    bool isReg;
+    unsigned long size;
+    long long mtimeSec;
+    long long mtimeNsec;
+    unsigned long inode;
+};
+
+/// Cleared if the kernel does not know statx.
+std::atomic<bool> statxSupported(true);
+
+/**
+ * \brief Stat name relative to dirfd.
+ *
+ * Uses statx limited to type, size, mtime and inode, falls back to
+ * fstatat on kernels without statx.
+ */
+bool statAt(int dirfd, const char *name, bool follow, FileStat &st)
+{
+    int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+#ifdef STATX_BASIC_STATS
+    if (statxSupported) {
+        struct statx stx;
+        if (statx(dirfd, name, flags | AT_STATX_DONT_SYNC,
+                STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO, &stx) == 0) {
+            st.isDir = S_ISDIR(stx.stx_mode);
+            st.isReg = S_ISREG(stx.stx_mode);
+            st.size = stx.stx_size;
+            st.mtimeSec = stx.stx_mtime.tv_sec;
+            st.mtimeNsec = stx.stx_mtime.tv_nsec;
+            st.inode = stx.stx_ino;
+            return true;
+        }
+        if (errno != ENOSYS)
+            return false;
+        statxSupported = false;
+    }
+#endif
+    struct stat sb;
+    if (fstatat(dirfd, name, &sb, flags) < 0)
+        return false;
+    st.isDir = S_ISDIR(sb.st_mode);
+    st.isReg = S_ISREG(sb.st_mode);
+    st.size = sb.st_size;
+    st.mtimeSec = sb.st_mtim.tv_sec;
+    st.mtimeNsec = sb.st_mtim.tv_nsec;
+    st.inode = sb.st_ino;
+    return true;
+}
+
+/**
+ * \brief Offset between the unix epoch and the file clock epoch.
+ *
+ * The media item hash has always been the raw file clock count as
+ * given by std::filesystem::last_write_time(), statx results are
+ * converted with this offset so existing caches stay valid.
+ *
+ * \return Offset in nanoseconds.
+ */
+long long fileClockOffset()
+{
+    static const long long offset = [] {
+        using namespace std::chrono;
+        auto sys = duration_cast<nanoseconds>(system_clock::now().time_since_epoch());
+        auto file = duration_cast<nanoseconds>(fs::file_time_type::clock::now().time_since_epoch());
+        return duration_cast<nanoseconds>(round<seconds>(sys - file)).count();
+    }();
+    return offset;
+}
+
+} // namespace
+
+bool FileTreeWalker::statFile(const std::string &path, Entry &entry)
+{
+    FileStat st;
+    if (!statAt(AT_FDCWD, path.c_str(), true, st) || !st.isReg)
+        return false;
+    entry.path = path;
+    entry.size = st.size;
+    entry.hash = static_cast<unsigned long>(st.mtimeSec * 1000000000LL + st.mtimeNsec
+        - fileClockOffset());
+    entry.mtime = static_cast<std::time_t>(st.mtimeSec);
+    entry.inode = st.inode;
+    return true;
+}
+
+int FileTreeWalker::defaultWorkers()
+{
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (cores < 1)
+        cores = 1;
+    return std::min(cores, WALKER_DEFAULT_MAX_WORKERS);
+}
+
+FileTreeWalker::FileTreeWalker(int workers, Backend backend) :
+    workers_(workers > 0 ? workers : defaultWorkers()),
+    backend_(backend),
+    pending_(0),
+    queued_(0),
+    filter_(nullptr),
+    handler_(nullptr),
+    dirHandler_(nullptr),
+    dirDoneHandler_(nullptr),
+    cancelCheck_(nullptr),
+    cancelled_(false),
+    dirCount_(0),
+    fileCount_(0),
+    reusedCount_(0),
+    prunedCount_(0)
+{
+    for (size_t idx = 0; idx < workers_; ++idx)
+        queues_.push_back(std::make_unique<Queue>());
+}
+
+FileTreeWalker::~FileTreeWalker()
+{
+    // nothing to be done here, all workers are joined in walk()
+}
+
+void FileTreeWalker::setFileFilter(FileFilter filter)
+{
+    filter_ = std::move(filter);
+}
+
+void FileTreeWalker::setFileHandler(FileHandler handler)
+{
+    handler_ = std::move(handler);
+}
+
+void FileTreeWalker::setDirHandler(DirHandler handler)
+{
+    dirHandler_ = std::move(handler);
+}
+
+void FileTreeWalker::setDirDoneHandler(DirDoneHandler handler)
+{
+    dirDoneHandler_ = std::move(handler);
+}
+
+void FileTreeWalker::setCancelCheck(CancelCheck check)
+{
+    cancelCheck_ = std::move(check);
+}
+
+void FileTreeWalker::setSkipMarker(const std::string &name)
+{
+    skipMarker_ = name;
+}
+
+bool FileTreeWalker::cancelled() const
+{
+    return cancelled_;
+}
+
+unsigned long FileTreeWalker::directoryCount() const
+{
+    return dirCount_;
+}
+
+unsigned long FileTreeWalker::fileCount() const
+{
+    return fileCount_;
+}
+
+unsigned long FileTreeWalker::reusedCount() const
+{
+    return reusedCount_;
+}
+
+unsigned long FileTreeWalker::prunedCount() const
+{
+    return prunedCount_;
+}
+
+bool FileTreeWalker::walk(const std::string &root)
+{
+    dirCount_ = 0;
+    fileCount_ = 0;
+    reusedCount_ = 0;
+    prunedCount_ = 0;
+    cancelled_ = false;
+
+    // directory paths are handed out without trailing slash
+    std::string top = root;
+    while (top.size() > 1 && top.back() == '/')
+        top.pop_back();
+
+    // the root is read from the calling thread, this also tells us
+    // whether the device is readable at all before threads are
+    // spawned
+    pending_ = 1;
+    if (!visitDirectory(0, top)) {
+        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "Failed to read root directory '%s'", root.c_str());
+        pending_ = 0;
+        return false;
+    }
+    done();
+
+    std::vector<std::thread> threads;
+    for (size_t idx = 1; idx < workers_ && pending_ > 0; ++idx)
+        threads.emplace_back(&FileTreeWalker::run, this, idx);
+
+    run(0);
+
+    for (auto &thread : threads)
+        thread.join();
+
+    if (cancelled_)
+        LOG_INFO(MEDIA_INDEXER_PLUGIN, 0, "Walk of '%s' has been cancelled", root.c_str());
+    LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Walked '%s' with %zu workers, %lu directories (%lu reused, %lu pruned), %lu files",
+        root.c_str(), workers_, dirCount_.load(), reusedCount_.load(), prunedCount_.load(), fileCount_.load());
+    return true;
+}
+
+void FileTreeWalker::run(size_t idx)
+{
+    std::string dir;
+    while (pending_ > 0) {
+        if (pop(idx, dir)) {
+            visitDirectory(idx, dir);
+            done();
+            continue;
+        }
+
+        // nothing to steal right now, push() and the last done()
+        // notify under the idle lock so the wake up is not missed
+        std::unique_lock<std::mutex> lk(idleLock_);
+        idleCv_.wait(lk, [this] { return pending_ == 0 || queued_ > 0; });
+    }
+}
+
+bool FileTreeWalker::visitDirectory(size_t idx, const std::string &dir)
+{
+    // once cancelled the queues are only drained
+    if (!cancelled_ && cancelCheck_ && cancelCheck_())
+        cancelled_ = true;
+    if (cancelled_)
+        return true;
+
+    // held back at boot and during playback
+    Governor::Slot slot(Governor::Stage::Walk);
+    return readDirectory(idx, dir);
+}
+
+void FileTreeWalker::push(size_t idx, std::string dir)
+{
+    pending_++;
+    {
+        std::lock_guard<std::mutex> lk(queues_[idx]->lock);
+        queues_[idx]->dirs.push_back(std::move(dir));
+    }
+    queued_++;
+
+    // take the idle lock so a worker can not miss the notification
+    // between checking the predicate and going to sleep
+    std::lock_guard<std::mutex> lk(idleLock_);
+    idleCv_.notify_one();
+}
+
+bool FileTreeWalker::pop(size_t idx, std::string &dir)
+{
+    // own queue first, from the back to stay depth first and keep
+    // the directory cache warm
+    {
+        std::lock_guard<std::mutex> lk(queues_[idx]->lock);
+        if (!queues_[idx]->dirs.empty()) {
+            dir = std::move(queues_[idx]->dirs.back());
+            queues_[idx]->dirs.pop_back();
+            queued_--;
+            return true;
+        }
+    }
+
+    // steal the oldest, usually biggest, subtree from someone else
+    for (size_t off = 1; off < workers_; ++off) {
+        auto &victim = queues_[(idx + off) % workers_];
+        std::lock_guard<std::mutex> lk(victim->lock);
+        if (!victim->dirs.empty()) {
+            dir = std::move(victim->dirs.front());
+            victim->dirs.pop_front();
+            queued_--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void FileTreeWalker::done()
+{
+    if (--pending_ > 0)
+        return;
+
+    std::lock_guard<std::mutex> lk(idleLock_);
+    idleCv_.notify_all();
+}
+
+bool FileTreeWalker::readDirectory(size_t idx, const std::string &dir)
+{
+    if (dirHandler_) {
+        std::vector<std::string> subdirs;
+        switch (dirHandler_(dir, subdirs)) {
+        case DirAction::Prune:
+            prunedCount_++;
+            return true;
+        case DirAction::Reuse:
+            dirCount_++;
+            reusedCount_++;
+            for (auto &subdir : subdirs)
+                push(idx, std::move(subdir));
+            return true;
+        case DirAction::Descend:
+            break;
+        }
+    }
+
+    if (backend_ == Backend::Getdents)
+        return readDirectoryGetdents(idx, dir);
+    return readDirectoryStd(idx, dir);
+}
+
+void FileTreeWalker::handleFile(Entry &entry)
+{
+    fileCount_++;
+    if (handler_)
+        handler_(entry);
+}
+
+void FileTreeWalker::skipDirectory(const std::string &dir)
+{
+    LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Skip '%s', contains '%s'", dir.c_str(), skipMarker_.c_str());
+    prunedCount_++;
+    if (dirDoneHandler_)
+        dirDoneHandler_(dir);
+}
+
+bool FileTreeWalker::readDirectoryStd(size_t idx, const std::string &dir)
+{
+    std::error_code err;
+    fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied, err);
+    if (err) {
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to open directory '%s', error message : '%s'",
+            dir.c_str(), err.message().c_str());
+        return false;
+    }
+
+    // the directory is listed completely before anything is queued
+    // or handled, a skip marker may come last
+    std::vector<std::string> subdirs;
+    std::vector<fs::directory_entry> files;
+    for (auto end = fs::directory_iterator(); it != end; it.increment(err)) {
+        if (err) {
+            LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to read directory '%s', error message : '%s'",
+                dir.c_str(), err.message().c_str());
+            break;
+        }
+
+        const auto &file = *it;
+        if (!skipMarker_.empty() && file.path().filename() == skipMarker_) {
+            skipDirectory(dir);
+            return true;
+        }
+
+        // like recursive_directory_iterator we do not follow
+        // directory symlinks, this avoids loops on broken media
+        if (file.is_symlink(err)) {
+            if (!file.is_regular_file(err))
+                continue;
+        } else if (file.is_directory(err)) {
+            subdirs.push_back(file.path());
+            continue;
+        }
+
+        if (!file.is_regular_file(err))
+            continue;
+        files.push_back(file);
+    }
+    dirCount_++;
+
+    for (auto &subdir : subdirs)
+        push(idx, std::move(subdir));
+
+    for (const auto &file : files) {
+        Entry entry;
+        entry.path = file.path();
+        if (filter_ && !filter_(entry.path))
+            continue;
+
+        entry.size = file.file_size(err);
+        if (err) {
+            LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to get size of '%s', error message : '%s'",
+                entry.path.c_str(), err.message().c_str());
+            continue;
+        }
+        auto lastWrite = file.last_write_time(err);
+        if (err) {
+            LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to get time of '%s', error message : '%s'",
+                entry.path.c_str(), err.message().c_str());
+            continue;
+        }
+        entry.hash = static_cast<unsigned long>(lastWrite.time_since_epoch().count());
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(lastWrite.time_since_epoch());
+        entry.mtime = static_cast<std::time_t>((ns.count() + fileClockOffset()) / 1000000000LL);
+        entry.inode = 0;
+
+        handleFile(entry);
+    }
+
+    if (dirDoneHandler_)
+        dirDoneHandler_(dir);
+    return true;
+}
+
+bool FileTreeWalker::readDirectoryGetdents(size_t idx, const std::string &dir)
+{
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to open directory '%s', error message : '%s'",
+            dir.c_str(), strerror(errno));
+        return false;
+    }
+
+    thread_local std::vector<char> buf(WALKER_GETDENTS_BUFFER_SIZE);
+    std::string prefix = dir;
+    if (prefix.empty() || prefix.back() != '/')
+        prefix.append("/");
+
+    /// File found in the listing, maybe already stat'ed.
+    struct Candidate {
+        std::string name;
+        bool haveStat;
+        FileStat st;
+    };
+
+    // the directory is listed completely before anything is queued
+    // or handled, a skip marker may come last
+    std::vector<std::string> subdirs;
+    std::vector<Candidate> files;
+    for (;;) {
+        long len = syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (len < 0) {
+            LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to read directory '%s', error message : '%s'",
+                dir.c_str(), strerror(errno));
+            break;
+        }
+        if (len == 0)
+            break;
+
+        for (long pos = 0; pos < len;) {
+            auto dent = reinterpret_cast<LinuxDirent64 *>(buf.data() + pos);
+            pos += dent->d_reclen;
+
+            const char *name = dent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+
+            if (!skipMarker_.empty() && skipMarker_ == name) {
+                close(fd);
+                skipDirectory(dir);
+                return true;
+            }
+
+            // like the std backend we do not follow directory
+            // symlinks, a symlink is only taken if it points to a
+            // regular file
+            Candidate file { name, false, {} };
+            switch (dent->d_type) {
+            case DT_DIR:
+                subdirs.push_back(prefix + name);
+                continue;
+            case DT_REG:
+            case DT_LNK:
+                break;
+            case DT_UNKNOWN:
+                // some filesystems do not fill d_type, we have to
+                // stat to tell directories from files
+                if (!statAt(fd, name, false, file.st))
+                    continue;
+                if (file.st.isDir) {
+                    subdirs.push_back(prefix + name);
+                    continue;
+                }
+                file.haveStat = file.st.isReg;
+                break;
+            default:
+                continue;
+            }
+            files.push_back(std::move(file));
+        }
+    }
+    dirCount_++;
+
+    for (auto &subdir : subdirs)
+        push(idx, std::move(subdir));
+
+    for (auto &file : files) {
+        Entry entry;
+        entry.path = prefix + file.name;
+        if (filter_ && !filter_(entry.path))
+            continue;
+
+        auto &st = file.st;
+        if (!file.haveStat) {
+            if (!statAt(fd, file.name.c_str(), true, st)) {
+                // dangling symlinks are skipped silently
+                if (errno != ENOENT)
+                    LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to stat '%s', error message : '%s'",
+                        entry.path.c_str(), strerror(errno));
+                continue;
+            }
+            if (!st.isReg)
+                continue;
+        }
+
+        entry.size = st.size;
+        entry.hash = static_cast<unsigned long>(st.mtimeSec * 1000000000LL + st.mtimeNsec
+            - fileClockOffset());
+        entry.mtime = static_cast<std::time_t>(st.mtimeSec);
+        entry.inode = st.inode;
+
+        handleFile(entry);
+    }
+
+    close(fd);
+    if (dirDoneHandler_)
+        dirDoneHandler_(dir);
+    return true;
+}
@@ -0,0 +1,264 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Parallel file tree walker.
+ *
+ * Every directory is a task. Each worker keeps its own task deque,
+ * takes work from the back of it (depth first) and steals from the
+ * front of the other workers' deques if it runs dry. The calling
+ * thread acts as the first worker so a walker with a single worker
+ * does not create any thread at all.
+ *
+ * The default backend reads directories with large getdents64
+ * batches and trusts d_type where the filesystem provides it. A file
+ * is stat'ed once with statx and only if its name passed the file
+ * filter, unsupported files never cost a stat.
+ */
+class FileTreeWalker
+{
+public:
+    /// How directories are read.
+    enum class Backend {
+        Std,      ///< std::filesystem::directory_iterator.
+        Getdents  ///< getdents64 and statx.
+    };
+
+    /// What to do with a directory.
+    enum class DirAction {
+        Descend, ///< Read the directory.
+        Reuse,   ///< Do not read it, continue with the given subdirectories.
+        Prune    ///< Skip the directory and everything below.
+    };
+
+    /// Regular file found during the walk.
+    struct Entry {
+        /// Full file path.
+        std::string path;
+        /// File size in bytes.
+        unsigned long size;
+        /// Last modification time, used as media item hash.
+        unsigned long hash;
+        /// Last modification time in seconds since epoch.
+        std::time_t mtime;
+        /// Inode number, 0 if not known.
+        unsigned long inode;
+    };
+
+    /**
+     * \brief Called for each file name before anything else is
+     * known about it, return false to skip the file.
+     *
+     * Called concurrently from all workers.
+     */
+    typedef std::function<bool(const std::string &path)> FileFilter;
+
+    /**
+     * \brief Called for each accepted regular file.
+     *
+     * Called concurrently from all workers.
+     */
+    typedef std::function<void(Entry &entry)> FileHandler;
+
+    /**
+     * \brief Called for each directory before it is read.
+     *
+     * If the handler already knows the directory content it can
+     * return DirAction::Reuse and fill subdirs, the directory is not
+     * read then and the walk continues with subdirs.
+     *
+     * Called concurrently from all workers.
+     */
+    typedef std::function<DirAction(const std::string &dir,
+        std::vector<std::string> &subdirs)> DirHandler;
+
+    /**
+     * \brief Called once all files of a directory have been handled.
+     *
+     * Not called for directories which could not be read, a
+     * directory with the skip marker counts as done.
+     *
+     * Called concurrently from all workers.
+     */
+    typedef std::function<void(const std::string &dir)> DirDoneHandler;
+
+    /**
+     * \brief Called before each directory is read, return true to
+     * abandon the walk.
+     *
+     * Called concurrently from all workers.
+     */
+    typedef std::function<bool()> CancelCheck;
+
+    /**
+     * \brief Get the worker count to use if none is configured.
+     *
+     * \return Number of workers.
+     */
+    static int defaultWorkers();
+
+    /**
+     * \brief Stat a single file the way the walk does.
+     *
+     * Gives the same hash and inode as a walk would, for files
+     * reported outside a walk.
+     *
+     * \param[in] path Full file path.
+     * \param[out] entry The file attributes.
+     * \return False if the file is gone or no regular file, else true.
+     */
+    static bool statFile(const std::string &path, Entry &entry);
+
+    /**
+     * \brief Construct walker.
+     *
+     * \param[in] workers Number of workers, values < 1 select the default.
+     * \param[in] backend Directory reading backend.
+     */
+    FileTreeWalker(int workers = 0, Backend backend = Backend::Getdents);
+    virtual ~FileTreeWalker();
+
+    /// Set the file filter, all files are accepted if none is set.
+    void setFileFilter(FileFilter filter);
+
+    /// Set the file handler.
+    void setFileHandler(FileHandler handler);
+
+    /// Set the directory handler, all directories are read if none is set.
+    void setDirHandler(DirHandler handler);
+
+    /// Set the handler for completely handled directories.
+    void setDirDoneHandler(DirDoneHandler handler);
+
+    /// Set the cancel check, the walk always completes if none is set.
+    void setCancelCheck(CancelCheck check);
+
+    /**
+     * \brief Set the name of a file which excludes the directory it
+     * is in, e. g. '.nomedia'.
+     *
+     * \param[in] name The file name, empty to disable.
+     */
+    void setSkipMarker(const std::string &name);
+
+    /**
+     * \brief Walk the tree below root.
+     *
+     * Blocks until all directories have been processed. Directories
+     * that cannot be read are skipped.
+     *
+     * \param[in] root The directory to start with.
+     * \return False if root could not be read, else true.
+     */
+    bool walk(const std::string &root);
+
+    /// The last walk has been abandoned, its results are incomplete.
+    bool cancelled() const;
+
+    /// Number of directories visited by the last walk.
+    unsigned long directoryCount() const;
+
+    /// Number of files accepted by the last walk.
+    unsigned long fileCount() const;
+
+    /// Number of directories the last walk did not need to read.
+    unsigned long reusedCount() const;
+
+    /// Number of directories the last walk skipped with everything below.
+    unsigned long prunedCount() const;
+
+private:
+    /// Per worker directory task deque.
+    struct Queue {
+        std::mutex lock;
+        std::deque<std::string> dirs;
+    };
+
+    /// Worker loop.
+    void run(size_t idx);
+
+    /// Queue directory on worker idx.
+    void push(size_t idx, std::string dir);
+
+    /// Get next directory, own queue first, then steal.
+    bool pop(size_t idx, std::string &dir);
+
+    /// Check for cancellation, then read one directory within a
+    /// governor slot. A cancelled walk does not read anything.
+    bool visitDirectory(size_t idx, const std::string &dir);
+
+    /// Read one directory, queue subdirectories and handle files.
+    bool readDirectory(size_t idx, const std::string &dir);
+
+    /// Backend::Std implementation of readDirectory().
+    bool readDirectoryStd(size_t idx, const std::string &dir);
+
+    /// Backend::Getdents implementation of readDirectory().
+    bool readDirectoryGetdents(size_t idx, const std::string &dir);
+
+    /// Accept a file, count it and pass it on to the handler.
+    void handleFile(Entry &entry);
+
+    /// A directory contains the skip marker.
+    void skipDirectory(const std::string &dir);
+
+    /// Mark one directory task done.
+    void done();
+
+    /// Worker count.
+    size_t workers_;
+    /// Directory reading backend.
+    Backend backend_;
+    /// Task queues, one per worker.
+    std::vector<std::unique_ptr<Queue>> queues_;
+    /// Directory tasks queued or running.
+    std::atomic<long> pending_;
+    /// Directory tasks queued.
+    std::atomic<long> queued_;
+    /// Workers sleep on this if there is nothing to steal.
+    std::mutex idleLock_;
+    std::condition_variable idleCv_;
+
+    FileFilter filter_;
+    FileHandler handler_;
+    DirHandler dirHandler_;
+    DirDoneHandler dirDoneHandler_;
+    CancelCheck cancelCheck_;
+    /// Set once the cancel check fired, remaining tasks are dropped.
+    std::atomic<bool> cancelled_;
+    /// Name of the file which excludes its directory.
+    std::string skipMarker_;
+
+    /// Statistics of the last walk.
+    std::atomic<unsigned long> dirCount_;
+    std::atomic<unsigned long> fileCount_;
+    std::atomic<unsigned long> reusedCount_;
+    std::atomic<unsigned long> prunedCount_;
+};
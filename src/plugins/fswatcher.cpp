@@ -0,0 +1,322 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "fswatcher.h"
+
+#include <filesystem>
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+/// Events we are interested in, IN_CLOSE_WRITE instead of IN_MODIFY
+/// so files are not parsed while still being written.
+#define WATCHER_EVENT_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | \
+    IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW)
+
+/// Changes are delivered once no new event arrived for this time.
+#define WATCHER_SETTLE_TIME_MS 1000
+
+/// Read buffer size for inotify events.
+#define WATCHER_BUFFER_SIZE (16 * 1024)
+
+FsWatcher::FsWatcher(const std::string &root) :
+    root_(root),
+    fd_(-1),
+    wakeFd_(-1),
+    incomplete_(false),
+    overflow_(false),
+    running_(false),
+    changeHandler_(nullptr),
+    rescanHandler_(nullptr),
+    readyCheck_(nullptr),
+    dirFilter_(nullptr)
+{
+    // nothing to be done here
+}
+
+FsWatcher::~FsWatcher()
+{
+    stop();
+}
+
+void FsWatcher::setChangeHandler(ChangeHandler handler)
+{
+    changeHandler_ = std::move(handler);
+}
+
+void FsWatcher::setRescanHandler(RescanHandler handler)
+{
+    rescanHandler_ = std::move(handler);
+}
+
+void FsWatcher::setReadyCheck(ReadyCheck check)
+{
+    readyCheck_ = std::move(check);
+}
+
+void FsWatcher::setDirFilter(DirFilter filter)
+{
+    dirFilter_ = std::move(filter);
+}
+
+bool FsWatcher::open()
+{
+    if (fd_ >= 0)
+        return true;
+
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        LOG_ERROR(MEDIA_INDEXER_FSWATCHER, 0, "Failed to init inotify, error message : '%s'", strerror(errno));
+        return false;
+    }
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+        LOG_ERROR(MEDIA_INDEXER_FSWATCHER, 0, "Failed to create eventfd, error message : '%s'", strerror(errno));
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+void FsWatcher::addWatch(const std::string &dir)
+{
+    if (fd_ < 0)
+        return;
+
+    int wd = inotify_add_watch(fd_, dir.c_str(), WATCHER_EVENT_MASK);
+    if (wd < 0) {
+        // removed meanwhile, the watch of its parent tells
+        if (errno == ENOENT)
+            return;
+        LOG_WARNING(MEDIA_INDEXER_FSWATCHER, 0, "Failed to watch '%s', error message : '%s'",
+            dir.c_str(), strerror(errno));
+        incomplete_ = true;
+        return;
+    }
+    std::lock_guard<std::mutex> lk(dirsLock_);
+    dirs_[wd] = dir;
+}
+
+bool FsWatcher::start()
+{
+    if (running_)
+        return true;
+    if (!open())
+        return false;
+
+    if (incomplete_) {
+        LOG_WARNING(MEDIA_INDEXER_FSWATCHER, 0, "Not all directories below '%s' are watched", root_.c_str());
+        stop();
+        return false;
+    }
+    LOG_INFO(MEDIA_INDEXER_FSWATCHER, 0, "Watching %zu directories below '%s'", dirs_.size(), root_.c_str());
+
+    running_ = true;
+    thread_ = std::thread(&FsWatcher::run, this);
+    return true;
+}
+
+void FsWatcher::pause()
+{
+    if (running_) {
+        running_ = false;
+        uint64_t val = 1;
+        if (write(wakeFd_, &val, sizeof(val)) < 0)
+            LOG_WARNING(MEDIA_INDEXER_FSWATCHER, 0, "Failed to wake up watcher for '%s'", root_.c_str());
+    }
+    if (thread_.joinable())
+        thread_.join();
+
+    // the next run must not stop right away
+    uint64_t val;
+    if (wakeFd_ >= 0 && read(wakeFd_, &val, sizeof(val)) < 0 && errno != EAGAIN)
+        LOG_WARNING(MEDIA_INDEXER_FSWATCHER, 0, "Failed to reset wake up of '%s'", root_.c_str());
+}
+
+void FsWatcher::stop()
+{
+    pause();
+
+    // closing the descriptor drops all watches
+    if (fd_ >= 0)
+        close(fd_);
+    if (wakeFd_ >= 0)
+        close(wakeFd_);
+    fd_ = wakeFd_ = -1;
+    dirs_.clear();
+    removed_.clear();
+    changed_.clear();
+    incomplete_ = false;
+    overflow_ = false;
+}
+
+void FsWatcher::run()
+{
+    struct pollfd fds[2];
+    fds[0].fd = fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeFd_;
+    fds[1].events = POLLIN;
+
+    while (running_) {
+        bool pending = overflow_ || !removed_.empty() || !changed_.empty();
+        int ret = poll(fds, 2, pending ? WATCHER_SETTLE_TIME_MS : -1);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR(MEDIA_INDEXER_FSWATCHER, 0, "poll failed, error message : '%s'", strerror(errno));
+            break;
+        }
+
+        if (!running_ || (fds[1].revents & POLLIN))
+            break;
+
+        if (fds[0].revents & POLLIN) {
+            readEvents();
+            continue;
+        }
+
+        // quiet for the settle time, deliver if the consumer is ready
+        if (pending && (!readyCheck_ || readyCheck_()))
+            dispatch();
+    }
+}
+
+void FsWatcher::readEvents()
+{
+    alignas(struct inotify_event) char buf[WATCHER_BUFFER_SIZE];
+
+    for (;;) {
+        ssize_t len = read(fd_, buf, sizeof(buf));
+        if (len <= 0)
+            break;
+
+        for (char *ptr = buf; ptr < buf + len;) {
+            auto ev = reinterpret_cast<struct inotify_event *>(ptr);
+            ptr += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                LOG_WARNING(MEDIA_INDEXER_FSWATCHER, 0, "Event queue overflow on '%s'", root_.c_str());
+                overflow_ = true;
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                dirs_.erase(ev->wd);
+                continue;
+            }
+
+            auto dir = dirs_.find(ev->wd);
+            if (dir == dirs_.end() || ev->len == 0)
+                continue;
+
+            std::string path = dir->second + "/" + ev->name;
+            if (ev->mask & IN_ISDIR) {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    removed_.erase(path);
+                    addWatches(path, true);
+                } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    removeWatches(path);
+                    removed_.insert(path);
+                }
+                continue;
+            }
+
+            if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                changed_.erase(path);
+                removed_.insert(path);
+            } else {
+                removed_.erase(path);
+                changed_.insert(path);
+            }
+        }
+    }
+}
+
+void FsWatcher::addWatches(const std::string &dir, bool report)
+{
+    // excluded directories are not indexed so we do not watch them
+    if (dirFilter_ && !dirFilter_(dir))
+        return;
+
+    int wd = inotify_add_watch(fd_, dir.c_str(), WATCHER_EVENT_MASK);
+    if (wd < 0) {
+        if (errno == ENOENT)
+            return;
+        // changes below dir would go unnoticed
+        LOG_WARNING(MEDIA_INDEXER_FSWATCHER, 0, "Failed to watch '%s', rescan, error message : '%s'",
+            dir.c_str(), strerror(errno));
+        overflow_ = true;
+        return;
+    }
+    dirs_[wd] = dir;
+
+    std::error_code err;
+    fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied, err);
+    if (err)
+        return;
+
+    for (auto end = fs::directory_iterator(); it != end; it.increment(err)) {
+        if (err)
+            break;
+        const auto &file = *it;
+        if (file.is_symlink(err))
+            continue;
+        if (file.is_directory(err))
+            addWatches(file.path(), report);
+        else if (report)
+            changed_.insert(file.path());
+    }
+}
+
+void FsWatcher::removeWatches(const std::string &dir)
+{
+    std::string prefix = dir + "/";
+    for (auto iter = dirs_.begin(); iter != dirs_.end();) {
+        if (iter->second == dir || !iter->second.compare(0, prefix.size(), prefix)) {
+            inotify_rm_watch(fd_, iter->first);
+            iter = dirs_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void FsWatcher::dispatch()
+{
+    if (overflow_) {
+        // the collected changes are incomplete anyway
+        overflow_ = false;
+        removed_.clear();
+        changed_.clear();
+        if (rescanHandler_)
+            rescanHandler_();
+        return;
+    }
+
+    LOG_DEBUG(MEDIA_INDEXER_FSWATCHER, "Changes on '%s', removed : %zu, changed : %zu",
+        root_.c_str(), removed_.size(), changed_.size());
+    if (changeHandler_)
+        changeHandler_(removed_, changed_);
+    removed_.clear();
+    changed_.clear();
+}
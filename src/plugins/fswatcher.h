@@ -0,0 +1,167 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * \brief Live file system change watcher.
+ *
+ * Watches all directories below a root with inotify and reports
+ * changed and removed paths in batches once the tree has been quiet
+ * for a moment. The tree is not read by the watcher, the scan walking
+ * it adds the watches with addWatch(). New directories are watched as
+ * they appear and the files found in them are reported as changed.
+ */
+class FsWatcher
+{
+public:
+    /**
+     * \brief Called with a batch of changes from the watcher thread.
+     *
+     * Removed paths may be files or directories, changed paths are
+     * files which have been created or modified.
+     */
+    typedef std::function<void(const std::set<std::string> &removed,
+        const std::set<std::string> &changed)> ChangeHandler;
+
+    /**
+     * \brief Called from the watcher thread if events have been lost
+     * and the tree needs a full scan.
+     */
+    typedef std::function<void()> RescanHandler;
+
+    /**
+     * \brief Called before a batch is delivered, return false to
+     * keep collecting, e. g. while a scan is still running.
+     */
+    typedef std::function<bool()> ReadyCheck;
+
+    /**
+     * \brief Called for each directory below the root, return false
+     * to not watch it and everything below.
+     */
+    typedef std::function<bool(const std::string &dir)> DirFilter;
+
+    /**
+     * \brief Construct watcher.
+     *
+     * \param[in] root The directory tree to watch.
+     */
+    FsWatcher(const std::string &root);
+    virtual ~FsWatcher();
+
+    /// Set the change handler.
+    void setChangeHandler(ChangeHandler handler);
+
+    /// Set the rescan handler.
+    void setRescanHandler(RescanHandler handler);
+
+    /// Set the ready check, changes are delivered right away if none is set.
+    void setReadyCheck(ReadyCheck check);
+
+    /// Set the directory filter, all directories are watched if none is set.
+    void setDirFilter(DirFilter filter);
+
+    /**
+     * \brief Create the inotify descriptor, watches can be added
+     * from now on.
+     *
+     * \return False if inotify is not available, else true.
+     */
+    bool open();
+
+    /**
+     * \brief Watch a single directory.
+     *
+     * May be called from several threads, but not while the watcher
+     * thread runs. A directory which can not be watched makes
+     * start() fail, changes below it would go unnoticed.
+     *
+     * \param[in] dir The directory.
+     */
+    void addWatch(const std::string &dir);
+
+    /**
+     * \brief Start the watcher thread.
+     *
+     * Events which arrived since the watches have been added are
+     * handled first.
+     *
+     * \return False if inotify is not available or a watch is
+     * missing, else true.
+     */
+    bool start();
+
+    /// Stop the watcher thread, the watches stay and events queue up
+    /// until start() is called again.
+    void pause();
+
+    /// Stop the watcher thread and drop all watches.
+    void stop();
+
+private:
+    /// Watcher thread.
+    void run();
+
+    /// Handle all events read from the inotify descriptor.
+    void readEvents();
+
+    /// Watch a new dir and everything below, files are reported as
+    /// changed. A rescan is requested if a watch can not be added.
+    void addWatches(const std::string &dir, bool report);
+
+    /// Drop the watches for dir and everything below.
+    void removeWatches(const std::string &dir);
+
+    /// Deliver the collected changes.
+    void dispatch();
+
+    /// The watched tree.
+    std::string root_;
+    /// inotify descriptor.
+    int fd_;
+    /// Used to wake up the watcher thread for stopping.
+    int wakeFd_;
+    /// Watched directories.
+    std::unordered_map<int, std::string> dirs_;
+    /// Protects dirs_ while the scan adds watches.
+    std::mutex dirsLock_;
+    /// A directory added by the scan could not be watched.
+    std::atomic<bool> incomplete_;
+    /// Collected changes since the last dispatch.
+    std::set<std::string> removed_;
+    std::set<std::string> changed_;
+    /// Events have been lost.
+    bool overflow_;
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+
+    ChangeHandler changeHandler_;
+    RescanHandler rescanHandler_;
+    ReadyCheck readyCheck_;
+    DirFilter dirFilter_;
+};
@@ -105,6 +105,16 @@ void Usb::pdmUpdate(const pbnjson::JValue &dev, bool available)
 }
 #endif
 
+bool Usb::liveWatchSupported() const
+{
+    return true;
+}
+
+bool Usb::subtreeScanSupported() const
+{
+    return true;
+}
+
 int Usb::runDeviceDetection(bool start)
 {
 #if defined HAS_PDM
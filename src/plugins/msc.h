@@ -62,4 +62,10 @@ private:
 
     /// From plugin base class.
     int runDeviceDetection(bool start);
+
+    /// From plugin base class.
+    bool liveWatchSupported() const;
+
+    /// From plugin base class.
+    bool subtreeScanSupported() const;
 };
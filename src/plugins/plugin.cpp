@@ -18,13 +18,67 @@
 #include "ideviceobserver.h"
 #include "configurator.h"
 #include "cachemanager.h"
+#include "excludematcher.h"
+#include "filetreewalker.h"
+#include "durablefile.h"
+#include "pipelinestage.h"
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <cinttypes>
+#include <mutex>
 
 #include <gio/gio.h>
 
 namespace fs = std::filesystem;
+
+/// The exclude configuration compiled on first use.
+static const ExcludeMatcher &excludeMatcher()
+{
+    static const ExcludeMatcher matcher(Configurator::instance()->getExcludeConfig());
+    return matcher;
+}
+
+namespace {
+
+/**
+ * \brief Flushes the scan progress to the cache journal from time to
+ * time so an interrupted scan can be resumed.
+ *
+ * The caller has to hold the lock protecting the cache.
+ */
+class Checkpointer
+{
+public:
+    Checkpointer(std::shared_ptr<Cache> cache) :
+        cache_(std::move(cache)),
+        interval_(Configurator::instance()->getScanCheckpointInterval()),
+        next_(std::chrono::steady_clock::now() + interval_)
+    {
+        // nothing to be done here
+    }
+
+    /// Save a checkpoint if the interval has passed.
+    void update()
+    {
+        if (interval_.count() <= 0)
+            return;
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_)
+            return;
+        if (!cache_->saveCheckpoint())
+            LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to save scan checkpoint '%s'", cache_->getPath().c_str());
+        next_ = now + interval_;
+    }
+
+private:
+    std::shared_ptr<Cache> cache_;
+    std::chrono::seconds interval_;
+    std::chrono::steady_clock::time_point next_;
+};
+
+} // namespace
+
 bool Plugin::matchUri(const std::string &refUri, const std::string &testUri)
 {
     return !testUri.compare(0, refUri.size(), refUri);
@@ -32,7 +86,14 @@ bool Plugin::matchUri(const std::string &refUri, const std::string &testUri)
 
 Plugin::~Plugin()
 {
-    // Nothing to be done here.
+    // the watchers call back into this object, they are joined without
+    // watchLock_ held
+    std::map<std::string, std::unique_ptr<FsWatcher>> watchers;
+    {
+        std::lock_guard<std::mutex> lk(watchLock_);
+        watchers.swap(watchers_);
+    }
+    watchers.clear();
 }
 
 void Plugin::lock()
@@ -196,6 +257,7 @@ bool Plugin::removeDevice(const std::string &uri)
     if (!dev)
         return false;
 
+    stopLiveWatch(uri);
     auto changed = dev->setAvailable(false);
 
     // now tell the observers if availability changed
@@ -207,11 +269,18 @@ bool Plugin::removeDevice(const std::string &uri)
 
 void Plugin::removeAll(void)
 {
-    std::shared_lock lock(lock_);
+    std::map<std::string, std::shared_ptr<Device>> devices;
+    {
+        std::shared_lock lock(lock_);
+        devices = devices_;
+    }
 
-    // mark the device as not available and notify observers if the
-    // available state really changed
-    for (const auto &dev :  devices_) {
+    // the watcher threads are joined without lock_ held, a change
+    // handler may just be waiting for it. Mark the device as not
+    // available and notify observers if the available state really
+    // changed.
+    for (const auto &dev : devices) {
+        stopLiveWatch(dev.first);
         if (dev.second->setAvailable(false))
             notifyObserversStateChange(dev.second);
     }
@@ -289,14 +358,34 @@ void Plugin::scan(const std::string &uri)
     }
     LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "file scan start for mountpoint : %s!", mp.c_str());
 
+    // the scan takes over, the watcher is restarted afterwards with
+    // the watches the walk has added
+    stopLiveWatch(uri);
+    auto watcher = createLiveWatch(mp);
+
     bool newMountedDevice = dev->isNewMountedDevice();
     bool ret = false;
+    std::shared_ptr<Cache> cache;
+    if (newMountedDevice) {
+        // an interrupted scan left its results in the database, go on
+        // from its checkpoint instead of starting over
+        cache = CacheManager::instance()->readCache(dev->uri(), dev->uuid());
+        if (cache && cache->isResumable()) {
+            LOG_INFO(MEDIA_INDEXER_PLUGIN, 0, "Resume interrupted scan of '%s'", dev->uri().c_str());
+            dev->setNewMountedDevice(false);
+            newMountedDevice = false;
+        } else if (cache) {
+            // a full scan starts with a new cache
+            cache.reset();
+            CacheManager::instance()->releaseCache(dev->uri());
+        }
+    }
     if (newMountedDevice) {
         LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Device %s is new mounted device!", dev->uri().c_str());
-        ret = doFileTreeWalk(dev, obs, mp);
+        ret = doFileTreeWalk(dev, obs, mp, cache, watcher.get());
     } else {
         LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Device %s is not new mounted device, cache is used!", dev->uri().c_str());
-        ret = doFileTreeWalkWithCache(dev, obs, mp);
+        ret = doFileTreeWalkWithCache(dev, obs, mp, cache, watcher.get());
     }
 
     if (!ret) {
@@ -304,164 +393,538 @@ void Plugin::scan(const std::string &uri)
         return;
     }
 
+    if (watcher)
+        startLiveWatch(dev, obs, mp, std::move(cache), std::move(watcher));
+
     LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Scan has been completed for uri : %s!", uri.c_str());
 }
 
+void Plugin::scanSubtree(const std::string &uri, const std::string &path)
+{
+    if (!subtreeScanSupported()) {
+        scan(uri);
+        return;
+    }
+
+    LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Subtree scan start! uri : %s, path : %s", uri.c_str(), path.c_str());
+    auto dev = device(uri);
+    if (!dev)
+        return;
+
+    auto obs = dev->observer();
+    if (!obs) {
+        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "device %s has no observer, observer is manadatory", dev->uri().c_str());
+        return;
+    }
+
+    auto mp = dev->mountpoint();
+    if (mp.empty()) {
+        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "Device '%s' has no mountpoint", dev->uri().c_str());
+        return;
+    }
+
+    // without committed results there is nothing to compare against
+    if (dev->isNewMountedDevice()) {
+        LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Device %s is new mounted device, full scan!", dev->uri().c_str());
+        scan(uri);
+        return;
+    }
+
+    // a file is rescanned with its directory, this also covers files
+    // which have been removed in the meantime
+    std::string subtree = path;
+    while (subtree.size() > 1 && subtree.back() == '/')
+        subtree.pop_back();
+    std::error_code err;
+    if (!fs::is_directory(subtree, err))
+        subtree = fs::path(subtree).parent_path();
+
+    std::string top = mp;
+    while (top.size() > 1 && top.back() == '/')
+        top.pop_back();
+    if (subtree.size() <= top.size() || subtree.compare(0, top.size(), top) ||
+        subtree[top.size()] != '/' || !fs::is_directory(subtree, err)) {
+        scan(uri);
+        return;
+    }
+
+    // the watches outside the subtree are still valid, the walk adds
+    // the new ones
+    auto watcher = takeLiveWatch(uri);
+
+    std::shared_ptr<Cache> cache;
+    if (!doFileTreeWalkWithCache(dev, obs, mp, cache, watcher.get(), subtree)) {
+        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "Failed file-tree-walk for '%s'", subtree.c_str());
+        return;
+    }
+
+    if (watcher)
+        startLiveWatch(dev, obs, mp, std::move(cache), std::move(watcher));
+
+    LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Subtree scan has been completed for '%s'!", subtree.c_str());
+}
+
 bool Plugin::doFileTreeWalkWithCache(const std::shared_ptr<Device>& device,
                                      IMediaItemObserver* observer,
-                                     const std::string& mountPoint)
+                                     const std::string& mountPoint,
+                                     std::shared_ptr<Cache>& cache,
+                                     FsWatcher* watcher,
+                                     const std::string& subtree)
 {
     auto configurator = Configurator::instance();
     auto cacheMgr = CacheManager::instance();
-    auto cache = cacheMgr->readCache(device->uri(), device->uuid());
+    if (!cache)
+        cache = cacheMgr->readCache(device->uri(), device->uuid());
     if (!cache) {
         LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Failed to get the cache for '%s'. let's try full scanning instead!",
                 device->uri().c_str());
-        return doFileTreeWalk(device, observer, mountPoint);
+        return doFileTreeWalk(device, observer, mountPoint, cache, watcher);
     }
 
-    try {
-        for (const auto &file : fs::recursive_directory_iterator(mountPoint)) {
-            std::error_code err;
-            if (!file.is_regular_file(err)) {
-                LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "'%s' is not regular file. error message : '%s'",
-                        file.path().c_str(), err.message().c_str());
-                continue;
-            }
-
-            std::string path = file.path();
-            std::string mimeType;
-            if (isHiddenfolder(path))
-                continue;
+    // everything outside the subtree stays as it is, only what is
+    // left in the cache after the walk gets removed
+    std::string root = mountPoint;
+    if (!subtree.empty()) {
+        std::vector<MediaItem::Type> types;
+        cache->carryOverOutside(subtree, types);
+        for (auto type : types) {
+            device->incrementMediaItemCount(type);
+            device->incrementProcessedItemCount(type);
+        }
+        root = subtree;
+    }
 
-            std::string ext = path.substr(path.find_last_of('.') + 1);
-            auto typeInfo = configurator->getTypeInfo(ext);
-            if (typeInfo.first == MediaItem::Type::EOL) {
-                LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "'%s' is NOT supported!", ext.c_str());
-                continue;
+    // the cache is not thread safe, only its lookups and inserts are
+    // serialised, the observer is called by the walker workers in parallel
+    std::mutex walkLock;
+    Checkpointer checkpointer(cache);
+    FileTreeWalker walker(configurator->getFileTreeWalkThreads());
+    walker.setFileFilter([this, configurator] (const std::string &path) -> bool {
+        return isSupportedFile(configurator, path);
+    });
+    const auto &matcher = excludeMatcher();
+    walker.setSkipMarker(matcher.skipMarker());
+    // stop early if the device goes away or another scan is requested
+    auto generation = device->scanGeneration();
+    walker.setCancelCheck([&device, generation] () -> bool {
+        return device->scanCancelled(generation);
+    });
+    // a subtree scan is requested because something changed in
+    // there, file modifications do not touch the directory time
+    bool skipUnchanged = subtree.empty() && configurator->getSkipUnchangedDirectories();
+    walker.setDirHandler([&] (const std::string &dir, std::vector<std::string> &subdirs) {
+        if (matcher.excludeDirectory(mountPoint, dir))
+            return FileTreeWalker::DirAction::Prune;
+        // watched before it is read, also if it is taken from the cache
+        if (watcher)
+            watcher->addWatch(dir);
+
+        std::error_code err;
+        auto lastWrite = fs::last_write_time(dir, err);
+        if (err)
+            return FileTreeWalker::DirAction::Descend;
+        unsigned long hash = static_cast<unsigned long>(lastWrite.time_since_epoch().count());
+
+        std::lock_guard<std::mutex> lk(walkLock);
+        // entries are only added to or removed from a directory by
+        // changing its modification time, the files of an unchanged
+        // directory can be taken over without listing it
+        std::vector<MediaItem::Type> types;
+        if (skipUnchanged && cache->carryOverDirectory(dir, hash, subdirs, types)) {
+            for (auto type : types) {
+                device->incrementMediaItemCount(type);
+                device->incrementProcessedItemCount(type);
             }
-
-            auto type = typeInfo.first;
-            auto extractorType = typeInfo.second;
-            auto fileSize = file.file_size();
-            auto lastWrite = file.last_write_time();
-            auto hash = static_cast<unsigned long>(lastWrite.time_since_epoch().count());
-
+            return FileTreeWalker::DirAction::Reuse;
+        }
+        cache->insertDirectory(dir, hash);
+        return FileTreeWalker::DirAction::Descend;
+    });
+    // files which may have been moved can only be told apart from
+    // new ones once the walk is complete, their directories are not
+    // done before
+    std::vector<FileTreeWalker::Entry> moved;
+    std::set<std::string> movedDirs;
+    walker.setDirDoneHandler([&] (const std::string &dir) {
+        std::lock_guard<std::mutex> lk(walkLock);
+        if (movedDirs.find(dir) == movedDirs.end())
+            cache->completeDirectory(dir);
+        checkpointer.update();
+    });
+    walker.setFileHandler([&] (FileTreeWalker::Entry &entry) {
+        PipelineStage::Scope scan(PipelineStage::Id::Scan);
+        std::string mimeType;
+        std::string ext = entry.path.substr(entry.path.find_last_of('.') + 1);
+        auto typeInfo = configurator->getTypeInfo(ext);
+        auto type = typeInfo.first;
+        auto extractorType = typeInfo.second;
+        if (type == MediaItem::Type::EOL)
+            return;
+
+        MediaItemPtr mi;
+        {
+            std::lock_guard<std::mutex> lk(walkLock);
             // check the cache whether exist or not
-            bool exist = cache->isExist(path, hash);
+            bool exist = cache->isExist(entry.path, entry.hash);
             if (exist) {
-                LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "not needed extraction for path '%s' and hash '%" PRIu64 "'",
-                        ext.c_str(), hash);
+                LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "not needed extraction for path '%s' and hash '%lu'",
+                        entry.path.c_str(), entry.hash);
                 device->incrementMediaItemCount(type);
                 device->incrementProcessedItemCount(type);
-                continue;
+                return;
             }
 
-            MediaItemPtr mi = std::make_unique<MediaItem>(device, path, mimeType, hash,
-                    fileSize, ext, type, extractorType);
+            if (cache->isRenameCandidate(entry.hash, entry.size)) {
+                movedDirs.insert(entry.path.substr(0, entry.path.find_last_of('/')));
+                moved.push_back(std::move(entry));
+                return;
+            }
+
+            mi = std::make_unique<MediaItem>(device, entry.path, mimeType, entry.hash,
+                    entry.size, ext, type, extractorType);
+            mi->setModifiedTime(entry.mtime);
             auto thumbnail = mi->getThumbnailFileName();
-            cache->insertItem(path, hash, type, thumbnail);
-            observer->newMediaItem(std::move(mi));
+            cache->insertItem(entry.path, entry.hash, type, thumbnail, entry.size, entry.inode);
         }
-    } catch (const std::exception &ex) {
-        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "Exception caught while traversing through '%s', exception : %s",
-            mountPoint.c_str(), ex.what());
+        // the observer may wait for the database or a full extraction
+        // queue, other walker workers go on meanwhile
+        observer->newMediaItem(std::move(mi));
+    });
+
+    // a root which can not be read is no empty device, nothing must
+    // be taken as removed then
+    bool walked = walker.walk(root);
+    if (!walked)
+        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "Failed to traverse through '%s'", root.c_str());
+    if (!walked || !device->available() || walker.cancelled() || device->scanCancelled(generation)) {
+        // the walk result is incomplete, keep what we have for the
+        // next attach
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Scan of device '%s' has been interrupted",
+            device->uri().c_str());
+        cache->saveCheckpoint();
+        return false;
     }
     LOG_INFO(MEDIA_INDEXER_PLUGIN, 0, "File-tree-walk(with cache) on device '%s' has been completed",
         device->uri().c_str());
+    PipelineStage::logStats();
+
+    // a moved file keeps its database entry and thumbnail, the meta
+    // data does not need to be extracted again
+    for (const auto &entry : moved) {
+        std::string mimeType;
+        std::string ext = entry.path.substr(entry.path.find_last_of('.') + 1);
+        auto typeInfo = configurator->getTypeInfo(ext);
+        auto type = typeInfo.first;
+        auto extractorType = typeInfo.second;
+
+        MediaItemPtr mi = std::make_unique<MediaItem>(device, entry.path, mimeType, entry.hash,
+                entry.size, ext, type, extractorType);
+        mi->setModifiedTime(entry.mtime);
+
+        std::string oldUri;
+        if (cache->carryOverRenamed(entry.path, entry.hash, entry.size, entry.inode, oldUri)) {
+            auto cached = cache->getItem(entry.path);
+            if (cached && std::get<1>(*cached) == type) {
+                mi->setThumbnailFileName(std::get<2>(*cached));
+                observer->renameMediaItem(std::move(mi), oldUri);
+                continue;
+            }
+            // the extension changed the media type, start over
+            CacheMap stale;
+            if (cached)
+                stale.emplace(oldUri, std::move(*cached));
+            removeCachedItems(device, observer, stale);
+        }
+
+        auto thumbnail = mi->getThumbnailFileName();
+        cache->updateItem(entry.path, entry.hash, type, thumbnail, entry.size, entry.inode);
+        observer->newMediaItem(std::move(mi));
+    }
+    for (const auto &dir : movedDirs)
+        cache->completeDirectory(dir);
 
     // we have to remove remaining cache with mediaDB.
-    auto remainingCache = cache->getRemainingCache();
-    for (auto& item : remainingCache) {
+    removeCachedItems(device, observer, cache->getRemainingCache());
+
+    // cache hits are counted right away, nothing else triggers the
+    // flush of a small batch of renames, dirty flags and removals
+    observer->flushUnflagDirty(device.get());
+    observer->flushDeleteItems(device.get());
+    bool ret = cacheMgr->generateCacheFile(device->uri(), cache);
+    if (!ret)
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Cache file generation fail for '%s'", device->uri().c_str());
+    return true;
+}
+
+bool Plugin::doFileTreeWalk(const std::shared_ptr<Device> &device,
+                            IMediaItemObserver* observer,
+                            const std::string& mountPoint,
+                            std::shared_ptr<Cache>& cache,
+                            FsWatcher* watcher)
+{
+    auto configurator = Configurator::instance();
+    auto cacheMgr = CacheManager::instance();
+    cache = cacheMgr->createCache(device->uri(), device->uuid());
+
+    // the cache is not thread safe, only its lookups and inserts are
+    // serialised, the observer is called by the walker workers in parallel
+    std::mutex walkLock;
+    Checkpointer checkpointer(cache);
+    FileTreeWalker walker(configurator->getFileTreeWalkThreads());
+    walker.setFileFilter([this, configurator] (const std::string &path) -> bool {
+        return isSupportedFile(configurator, path);
+    });
+    const auto &matcher = excludeMatcher();
+    walker.setSkipMarker(matcher.skipMarker());
+    // stop early if the device goes away or another scan is requested
+    auto generation = device->scanGeneration();
+    walker.setCancelCheck([&device, generation] () -> bool {
+        return device->scanCancelled(generation);
+    });
+    walker.setDirHandler([&] (const std::string &dir, std::vector<std::string> &subdirs) {
+        if (matcher.excludeDirectory(mountPoint, dir))
+            return FileTreeWalker::DirAction::Prune;
+        if (watcher)
+            watcher->addWatch(dir);
+
+        // remember the directory state for the next rescan, taken
+        // before the directory is read so changes during the walk
+        // are not lost
+        std::error_code err;
+        auto lastWrite = fs::last_write_time(dir, err);
+        if (!err) {
+            std::lock_guard<std::mutex> lk(walkLock);
+            cache->insertDirectory(dir, static_cast<unsigned long>(lastWrite.time_since_epoch().count()));
+        }
+        return FileTreeWalker::DirAction::Descend;
+    });
+    walker.setDirDoneHandler([&] (const std::string &dir) {
+        std::lock_guard<std::mutex> lk(walkLock);
+        cache->completeDirectory(dir);
+        checkpointer.update();
+    });
+    walker.setFileHandler([&] (FileTreeWalker::Entry &entry) {
+        PipelineStage::Scope scan(PipelineStage::Id::Scan);
+        std::string mimeType;
+        std::string ext = entry.path.substr(entry.path.find_last_of('.') + 1);
+        auto typeInfo = configurator->getTypeInfo(ext);
+        auto type = typeInfo.first;
+        auto extractorType = typeInfo.second;
+        if (type == MediaItem::Type::EOL)
+            return;
+
+        MediaItemPtr mi = std::make_unique<MediaItem>(device, entry.path, mimeType, entry.hash,
+                entry.size, ext, type, extractorType);
+        mi->setModifiedTime(entry.mtime);
+        auto thumbnail = mi->getThumbnailFileName();
+        {
+            std::lock_guard<std::mutex> lk(walkLock);
+            cache->insertItem(entry.path, entry.hash, type, thumbnail, entry.size, entry.inode);
+        }
+        observer->newMediaItem(std::move(mi));
+    });
+
+    bool walked = walker.walk(mountPoint);
+    if (!walked)
+        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "Failed to traverse through '%s'", mountPoint.c_str());
+    if (!walked || !device->available() || walker.cancelled() || device->scanCancelled(generation)) {
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Scan of device '%s' has been interrupted",
+            device->uri().c_str());
+        cache->saveCheckpoint();
+        return false;
+    }
+    LOG_INFO(MEDIA_INDEXER_PLUGIN, 0, "File-tree-walk on device '%s' has been completed",
+        device->uri().c_str());
+    PipelineStage::logStats();
+    observer->flushStatRows(device.get());
+
+    bool ret = cacheMgr->generateCacheFile(device->uri(), cache);
+    if (!ret)
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Cache file generation fail for '%s'", device->uri().c_str());
+
+    return true;
+}
+
+void Plugin::removeCachedItems(const std::shared_ptr<Device>& device,
+                               IMediaItemObserver* observer,
+                               const CacheMap& items)
+{
+    UnlinkBatch thumbnails;
+    for (auto& item : items) {
         auto uri = item.first;
         auto hash = std::get<0>(item.second);
         auto type = std::get<1>(item.second);
         const auto &thumb = std::get<2>(item.second);
-        std::string ext = uri.substr(uri.find_last_of('.') + 1);
 
         // we don't have to increase media item count.
         MediaItemPtr mi = std::make_unique<MediaItem>(device, uri, hash, type);
 
         // let's first remove thumbnail.
-        std::string filePath = THUMBNAIL_DIRECTORY + device->uuid() + "/" + thumb;
-        std::filesystem::remove(filePath);
+        if (!thumb.empty())
+            thumbnails.add(THUMBNAIL_DIRECTORY + device->uuid() + "/" + thumb);
         // now, we have to remove database for syncronization
         observer->removeMediaItem(std::move(mi));
     }
-    bool ret = cacheMgr->generateCacheFile(device->uri(), cache);
-    if (!ret)
-        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Cache file generation fail for '%s'", device->uri().c_str());
-    sync();
-    return true;
+    thumbnails.commit();
 }
 
-bool Plugin::doFileTreeWalk(const std::shared_ptr<Device> &device,
+std::unique_ptr<FsWatcher> Plugin::createLiveWatch(const std::string& mountPoint)
+{
+    if (!Configurator::instance()->getLiveWatch() || !liveWatchSupported())
+        return nullptr;
+
+    // events arriving during the walk queue up in the kernel until
+    // the watcher is started
+    auto watcher = std::make_unique<FsWatcher>(mountPoint);
+    if (!watcher->open())
+        return nullptr;
+    return watcher;
+}
+
+void Plugin::startLiveWatch(const std::shared_ptr<Device>& device,
                             IMediaItemObserver* observer,
-                            const std::string& mountPoint)
+                            const std::string& mountPoint,
+                            std::shared_ptr<Cache> cache,
+                            std::unique_ptr<FsWatcher> watcher)
+{
+    if (!cache)
+        return;
+
+    watcher->setDirFilter([mountPoint] (const std::string &dir) -> bool {
+        return !excludeMatcher().excludeDirectory(mountPoint, dir);
+    });
+    // changes are held back until the scan results are committed
+    watcher->setReadyCheck([device] () -> bool {
+        return device->state() == Device::State::Idle;
+    });
+    watcher->setChangeHandler([this, device, observer, cache] (const std::set<std::string> &removed,
+            const std::set<std::string> &changed) {
+        handleLiveChanges(device, observer, cache, removed, changed);
+    });
+    watcher->setRescanHandler([device, observer] () {
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Lost changes on '%s', rescan", device->uri().c_str());
+        device->scan(observer);
+    });
+    if (!watcher->start()) {
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Live watch for '%s' not available", device->uri().c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lk(watchLock_);
+    watchers_[device->uri()] = std::move(watcher);
+}
+
+std::unique_ptr<FsWatcher> Plugin::takeLiveWatch(const std::string &uri)
+{
+    std::unique_ptr<FsWatcher> watcher;
+    {
+        std::lock_guard<std::mutex> lk(watchLock_);
+        auto iter = watchers_.find(uri);
+        if (iter == watchers_.end())
+            return nullptr;
+        watcher = std::move(iter->second);
+        watchers_.erase(iter);
+    }
+    // joins the watcher thread
+    watcher->pause();
+    return watcher;
+}
+
+void Plugin::stopLiveWatch(const std::string &uri)
+{
+    auto watcher = takeLiveWatch(uri);
+    if (!watcher)
+        return;
+    watcher.reset();
+    LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Live watch for '%s' stopped", uri.c_str());
+}
+
+void Plugin::handleLiveChanges(const std::shared_ptr<Device>& device,
+                               IMediaItemObserver* observer,
+                               const std::shared_ptr<Cache>& cache,
+                               const std::set<std::string>& removed,
+                               const std::set<std::string>& changed)
 {
     auto configurator = Configurator::instance();
-    auto cacheMgr = CacheManager::instance();
-    auto cache = cacheMgr->createCache(device->uri(), device->uuid());
-
-    try {
-        for (auto &file : fs::recursive_directory_iterator(mountPoint)) {
-            std::error_code err;
-            if (!file.is_regular_file(err)) {
-                LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "'%s' is not regular file. error message : '%s'",
-                        file.path().c_str(), err.message().c_str());
-                continue;
-            }
 
-            std::string path = file.path();
-            std::string mimeType;
-            if (isHiddenfolder(path))
-                continue;
+    // the scan results are in the database now, from here on single
+    // items are checked and merged
+    if (device->isNewMountedDevice())
+        device->setNewMountedDevice(false);
 
-            std::string ext = path.substr(path.find_last_of('.') + 1);
-            auto typeInfo = configurator->getTypeInfo(ext);
-            if (typeInfo.first == MediaItem::Type::EOL) {
-                LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "'%s' is NOT supported!", ext.c_str());
-                continue;
-            }
+    for (const auto &path : removed)
+        removeCachedItems(device, observer, cache->removeItems(path));
 
-            auto type = typeInfo.first;
-            auto extractorType = typeInfo.second;
-            auto lastWrite = file.last_write_time();
-            auto fileSize = file.file_size();
-            auto hash = static_cast<unsigned long>(lastWrite.time_since_epoch().count());
-            MediaItemPtr mi = std::make_unique<MediaItem>(device, path, mimeType, hash,
-                    fileSize, ext, type, extractorType);
-            auto thumbnail = mi->getThumbnailFileName();
-            cache->insertItem(path, hash, type, thumbnail);
-            observer->newMediaItem(std::move(mi));
-
-            /*
-            if (MediaItem::mediaItemSupported(path, mimeType)) {
-                auto lastWrite = file.last_write_time();
-                auto fileSize = file.file_size();
-                auto hash = lastWrite.time_since_epoch().count();
-                MediaItemPtr mi(new MediaItem(device,
-                        path, mimeType, hash, fileSize));
-                obsserver->newMediaItem(std::move(mi));
-            } else {
-                LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "mediaItem : %s is not supported", path.c_str());
-            }
-            */
+    for (const auto &path : changed) {
+        if (!isSupportedFile(configurator, path))
+            continue;
+
+        // same hash and inode as the walk, a later rename can be
+        // carried over
+        FileTreeWalker::Entry entry;
+        if (!FileTreeWalker::statFile(path, entry)) {
+            // already gone again
+            removeCachedItems(device, observer, cache->removeItems(path));
+            continue;
         }
-    } catch (const std::exception &ex) {
-        LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "Exception caught while traversing through '%s', exception : %s",
-            mountPoint.c_str(), ex.what());
-        return false;
+
+        std::string mimeType;
+        std::string ext = path.substr(path.find_last_of('.') + 1);
+        auto typeInfo = configurator->getTypeInfo(ext);
+        auto type = typeInfo.first;
+        auto extractorType = typeInfo.second;
+        if (type == MediaItem::Type::EOL)
+            continue;
+
+        auto cached = cache->getItem(path);
+        if (cached && std::get<0>(*cached) == entry.hash)
+            continue;
+
+        LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "Live change for '%s'", path.c_str());
+        MediaItemPtr mi = std::make_unique<MediaItem>(device, path, mimeType, entry.hash,
+                entry.size, ext, type, extractorType);
+        mi->setModifiedTime(entry.mtime);
+        // keep the thumbnail name of a modified item
+        if (cached)
+            mi->setThumbnailFileName(std::get<2>(*cached));
+        cache->updateItem(path, entry.hash, type, mi->getThumbnailFileName(), entry.size, entry.inode);
+        observer->newMediaItem(std::move(mi));
     }
-    LOG_INFO(MEDIA_INDEXER_PLUGIN, 0, "File-tree-walk on device '%s' has been completed",
-        device->uri().c_str());
 
-    bool ret = cacheMgr->generateCacheFile(device->uri(), cache);
-    if (!ret)
-        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Cache file generation fail for '%s'", device->uri().c_str());
+    // nothing else triggers the flush of a small batch
+    observer->flushUnflagDirty(device.get());
+    observer->flushDeleteItems(device.get());
 
+    if (!cache->saveChanges())
+        LOG_WARNING(MEDIA_INDEXER_PLUGIN, 0, "Cache file update fail for '%s'", device->uri().c_str());
+}
+
+bool Plugin::liveWatchSupported() const
+{
+    // file-tree-walk plugins have to opt in
+    return false;
+}
+
+bool Plugin::subtreeScanSupported() const
+{
+    // file-tree-walk plugins have to opt in
+    return false;
+}
+
+bool Plugin::isSupportedFile(Configurator *configurator, const std::string &path)
+{
+    // excluded directories never get here, only the name is left
+    if (excludeMatcher().excludeFile(path))
+        return false;
+
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    if (!configurator->isSupportedExtension(ext)) {
+        LOG_DEBUG(MEDIA_INDEXER_PLUGIN, "'%s' is NOT supported!", ext.c_str());
+        return false;
+    }
     return true;
 }
+
 /*
 bool Plugin::checkFileInfomation(const fs::directory_entry& file)
 {
@@ -486,13 +949,6 @@ bool Plugin::checkFileInfomation(const fs::directory_entry& file)
     return true;
 }
 */
-bool Plugin::isHiddenfolder(std::string &filepath)
-{
-    if(filepath.find("/.") != -1)
-        return true;
-    return false;
-}
-
 void Plugin::extractMeta(MediaItem &mediaItem, bool expand)
 {
     LOG_ERROR(MEDIA_INDEXER_PLUGIN, 0, "No meta data extraction for '%s'", mediaItem.uri().c_str());
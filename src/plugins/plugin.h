@@ -16,17 +16,21 @@
 
 #pragma once
 
+#include "cache.h"
 #include "device.h"
+#include "fswatcher.h"
 #include "logging.h"
 
 #include <memory>
 #include <string>
 #include <list>
 #include <map>
+#include <mutex>
 #include <shared_mutex>
 
 class IDeviceObserver;
 class IMediaItemObserver;
+class Configurator;
 
 /**
  * \brief Base class for device plugins.
@@ -190,6 +194,19 @@ public:
      */
     virtual void scan(const std::string &uri);
 
+    /**
+     * \brief Rescan a directory below the device mountpoint.
+     *
+     * Only the given subtree is walked and compared against the
+     * cache, everything else is taken over from the last scan. Falls
+     * back to a full scan if the plugin does not support subtree
+     * scans or there is no cache to compare against.
+     *
+     * \param[in] uri The device uri.
+     * \param[in] path Directory or file below the mountpoint.
+     */
+    virtual void scanSubtree(const std::string &uri, const std::string &path);
+
     /**
      * \brief Does the meta data extraction.
      *
@@ -226,6 +243,22 @@ protected:
      */
     virtual int runDeviceDetection(bool start) = 0;
 
+    /**
+     * \brief Check if devices of this plugin can be watched for
+     * changes after the scan.
+     *
+     * \return True if live watch is supported, else false.
+     */
+    virtual bool liveWatchSupported() const;
+
+    /**
+     * \brief Check if devices of this plugin can be rescanned below
+     * a directory.
+     *
+     * \return True if subtree scans are supported, else false.
+     */
+    virtual bool subtreeScanSupported() const;
+
 private:
     /// Plugin must be constructed with uri.
     Plugin() {};
@@ -248,19 +281,53 @@ private:
     /// Notify the observer about a device modification.
     void notifyObserversModify(const std::shared_ptr<Device> &device) const;
 
-    /// Check if the path is a hidden file.
-    bool isHiddenfolder(std::string &filepath);
+    /// Check if the file shall be indexed, called from walker workers.
+    bool isSupportedFile(Configurator *configurator, const std::string &path);
 
 
     //TODO: need refactoring!
     bool doFileTreeWalk(const std::shared_ptr<Device>& device,
                         IMediaItemObserver* observer,
-                        const std::string& mountPoint);
+                        const std::string& mountPoint,
+                        std::shared_ptr<Cache>& cache,
+                        FsWatcher* watcher);
 
     //TODO: need refactoring!
     bool doFileTreeWalkWithCache(const std::shared_ptr<Device>& device,
                                  IMediaItemObserver* observer,
-                                 const std::string& mountPoint);
+                                 const std::string& mountPoint,
+                                 std::shared_ptr<Cache>& cache,
+                                 FsWatcher* watcher,
+                                 const std::string& subtree = "");
+
+    /// Remove cached items with their thumbnails from the database.
+    void removeCachedItems(const std::shared_ptr<Device>& device,
+                           IMediaItemObserver* observer,
+                           const CacheMap& items);
+
+    /// Create a watcher the scan of the device adds its watches to,
+    /// null if live watch is not enabled or not available.
+    std::unique_ptr<FsWatcher> createLiveWatch(const std::string& mountPoint);
+
+    /// Start watching the scanned device for changes.
+    void startLiveWatch(const std::shared_ptr<Device>& device,
+                        IMediaItemObserver* observer,
+                        const std::string& mountPoint,
+                        std::shared_ptr<Cache> cache,
+                        std::unique_ptr<FsWatcher> watcher);
+
+    /// Take the paused watcher of the device, its watches are kept.
+    std::unique_ptr<FsWatcher> takeLiveWatch(const std::string &uri);
+
+    /// Stop watching the device.
+    void stopLiveWatch(const std::string &uri);
+
+    /// Feed a batch of live changes into the media item pipeline.
+    void handleLiveChanges(const std::shared_ptr<Device>& device,
+                           IMediaItemObserver* observer,
+                           const std::shared_ptr<Cache>& cache,
+                           const std::set<std::string>& removed,
+                           const std::set<std::string>& changed);
 
     /// Lock this instance, this is locked when the observer is
     /// notified and the observer may call back into one of the
@@ -273,4 +340,8 @@ private:
     std::map<std::string, std::shared_ptr<Device>> devices_;
     /// List of device notification observers.
     std::list<IDeviceObserver *> deviceObservers_;
+    /// Live change watchers for scanned devices.
+    std::map<std::string, std::unique_ptr<FsWatcher>> watchers_;
+    /// Protects the watcher map.
+    std::mutex watchLock_;
 };
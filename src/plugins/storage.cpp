@@ -68,6 +68,16 @@ Storage::~Storage()
 {
 }
 
+bool Storage::liveWatchSupported() const
+{
+    return true;
+}
+
+bool Storage::subtreeScanSupported() const
+{
+    return true;
+}
+
 int Storage::runDeviceDetection(bool start)
 {
     LOG_DEBUG(MEDIA_INDEXER_STORAGE, "%s all configured paths", start ? "Set" : "Unset");
@@ -54,6 +54,12 @@ private:
     /// From plugin base class.
     int runDeviceDetection(bool start);
 
+    /// From plugin base class.
+    bool liveWatchSupported() const;
+
+    /// From plugin base class.
+    bool subtreeScanSupported() const;
+
     /// List of local storage paths to observe.
     std::list<StorageDevice> devs_;
 };
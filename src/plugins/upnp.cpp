@@ -20,9 +20,9 @@
 #include <cstdio>
 #include <sstream>
 #include <algorithm>
-#include <thread>
 
 #include "upnptools.h"
+#include "executor.h"
 
 std::shared_ptr<Plugin> Upnp::instance_ = nullptr;
 
@@ -306,8 +306,9 @@ void Upnp::serviceFound(const void *event)
         // now request the meta data for the new device, make a copy of
         // location which is destroyed when this method returns
         std::string loc(UpnpString_get_String(location));
-        std::thread t(getDeviceMeta, this, uri, loc);
-        t.detach(); // worker thread
+        Executor::instance()->post([this, uri, loc = std::move(loc)] () {
+            getDeviceMeta(this, uri, loc);
+        });
     }
 }
 
@@ -0,0 +1,186 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "poolsizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sched.h>
+
+/// Time between two sizing decisions.
+#define POOL_SIZER_INTERVAL_MS 2000
+/// Share of the available cpus above which we do not grow.
+#define POOL_SIZER_CPU_GROW 0.75
+/// Share of the available cpus above which we shrink.
+#define POOL_SIZER_CPU_SHRINK 0.95
+/// Share of iowait above which we do not grow.
+#define POOL_SIZER_IOWAIT_HIGH 0.20
+/// A step up has to raise the throughput by this factor to be kept.
+#define POOL_SIZER_MIN_GAIN 1.05
+/// A step up which made items this much slower is taken back.
+#define POOL_SIZER_MAX_SLOWDOWN 1.25
+
+PoolSizer::PoolSizer(size_t min, size_t max) :
+    min_(std::max<size_t>(min, 1)),
+    max_(std::max(min, max)),
+    capacity_(cpuCapacity()),
+    items_(0),
+    latencyUs_(0),
+    last_(std::chrono::steady_clock::now()),
+    grownFromRate_(0),
+    grownFromLatency_(0)
+{
+    readCpuTimes(lastTimes_);
+    LOG_INFO(MEDIA_INDEXER_MEDIAPARSER, 0, "Extraction workers %zu to %zu, %.2f cpus available",
+        min_, max_, capacity_);
+}
+
+size_t PoolSizer::initial() const
+{
+    // one worker per cpu, the sizer finds out whether the storage
+    // takes more
+    auto count = static_cast<size_t>(std::ceil(capacity_));
+    return std::clamp(count, min_, max_);
+}
+
+void PoolSizer::itemDone(std::chrono::microseconds latency)
+{
+    items_++;
+    latencyUs_ += latency.count();
+}
+
+size_t PoolSizer::update(size_t current, bool backlog)
+{
+    std::unique_lock<std::mutex> lock(lock_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return current;
+
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_).count();
+    if (elapsed < POOL_SIZER_INTERVAL_MS)
+        return current;
+
+    CpuTimes times;
+    if (!readCpuTimes(times))
+        return current;
+    auto total = times.total - lastTimes_.total;
+    auto idle = times.idle - lastTimes_.idle;
+    auto iowait = times.iowait - lastTimes_.iowait;
+    uint64_t items = items_.exchange(0);
+    uint64_t latencyUs = latencyUs_.exchange(0);
+    last_ = now;
+    lastTimes_ = times;
+    if (total == 0 || items == 0)
+        return current;
+
+    // busy cpus system wide against what we may use, other processes
+    // count as well, they compete for the same cpus
+    double cpus = static_cast<double>(std::thread::hardware_concurrency());
+    double busy = cpus * (total - idle - iowait) / total;
+    double iowaitShare = static_cast<double>(iowait) / total;
+    double rate = items * 1000.0 / elapsed;
+    double latency = static_cast<double>(latencyUs) / items;
+
+    size_t next = current;
+    if (grownFromRate_ > 0 && rate < grownFromRate_ * POOL_SIZER_MIN_GAIN &&
+        latency > grownFromLatency_ * POOL_SIZER_MAX_SLOWDOWN) {
+        // more workers only made each of them slower
+        next = current - 1;
+    } else if (busy > capacity_ * POOL_SIZER_CPU_SHRINK && current > std::ceil(capacity_)) {
+        next = current - 1;
+    } else if (backlog && busy < capacity_ * POOL_SIZER_CPU_GROW && iowaitShare < POOL_SIZER_IOWAIT_HIGH) {
+        next = current + 1;
+    }
+    next = std::clamp(next, min_, max_);
+
+    grownFromRate_ = next > current ? rate : 0;
+    grownFromLatency_ = next > current ? latency : 0;
+    if (next != current)
+        LOG_INFO(MEDIA_INDEXER_MEDIAPARSER, 0, "Extraction workers %zu -> %zu, cpu %.2f/%.2f, iowait %.0f%%"
+            ", %.1f items/s, %.0f ms per item", current, next, busy, capacity_, iowaitShare * 100,
+            rate, latency / 1000);
+    return next;
+}
+
+double PoolSizer::cpuCapacity()
+{
+    double cpus = 0;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        cpus = CPU_COUNT(&set);
+    if (cpus < 1)
+        cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    auto quota = cgroupQuota();
+    if (quota > 0)
+        cpus = std::min(cpus, quota);
+    return cpus;
+}
+
+bool PoolSizer::readCpuTimes(CpuTimes &times)
+{
+    std::ifstream stat("/proc/stat");
+    std::string line;
+    if (!std::getline(stat, line) || line.compare(0, 4, "cpu "))
+        return false;
+
+    // user nice system idle iowait irq softirq steal
+    std::istringstream fields(line.substr(4));
+    uint64_t value;
+    times = CpuTimes();
+    for (int idx = 0; idx < 8 && fields >> value; ++idx) {
+        times.total += value;
+        if (idx == 3)
+            times.idle = value;
+        else if (idx == 4)
+            times.iowait = value;
+    }
+    return times.total > 0;
+}
+
+double PoolSizer::cgroupQuota()
+{
+    // cgroup v2: "<quota> <period>" or "max <period>"
+    std::string path = "/sys/fs/cgroup";
+    std::ifstream cgroup("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroup, line)) {
+        if (!line.compare(0, 3, "0::")) {
+            path += line.substr(3);
+            break;
+        }
+    }
+    std::ifstream max(path + "/cpu.max");
+    if (!max.is_open())
+        max.open("/sys/fs/cgroup/cpu.max");
+    std::string quota;
+    double period = 0;
+    if (max >> quota >> period)
+        return quota == "max" || period <= 0 ? 0 : std::stod(quota) / period;
+
+    // cgroup v1, a negative quota means unlimited
+    std::ifstream quotaFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+    std::ifstream periodFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+    double quotaUs = 0;
+    if (quotaFile >> quotaUs && periodFile >> period && quotaUs > 0 && period > 0)
+        return quotaUs / period;
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "logging.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * \brief Picks the number of extraction workers at runtime.
+ *
+ * Extraction is cpu bound on fast storage and io bound on slow
+ * storage, no fixed worker count fits both. The sizer samples the
+ * system cpu times from /proc/stat every few seconds together with
+ * the number and latency of the extractions done in between and
+ * moves the worker count by one step at a time:
+ *
+ * - it grows while items are waiting, the cpus available to us are
+ *   not saturated and iowait is low,
+ * - it shrinks while the cpus are saturated or when the last step up
+ *   did not raise the throughput but made each item slower, which is
+ *   what a thrashing disk looks like.
+ *
+ * The cpus available to us are the online cpus of our affinity mask,
+ * limited by the cgroup cpu quota if there is one.
+ */
+class PoolSizer
+{
+public:
+    /**
+     * \brief Construct sizer.
+     *
+     * \param[in] min Lower worker limit.
+     * \param[in] max Upper worker limit.
+     */
+    PoolSizer(size_t min, size_t max);
+
+    /// Worker count to start with.
+    size_t initial() const;
+
+    /**
+     * \brief Count a finished extraction.
+     *
+     * \param[in] latency The time the extraction took.
+     */
+    void itemDone(std::chrono::microseconds latency);
+
+    /**
+     * \brief Check whether the worker count should change.
+     *
+     * Cheap unless the sample interval has passed, may be called
+     * after every item.
+     *
+     * \param[in] current The current worker count.
+     * \param[in] backlog Items are waiting for a worker.
+     * \return The new worker count, current if it stays.
+     */
+    size_t update(size_t current, bool backlog);
+
+    /// Cpus available to this process, the cgroup quota included.
+    static double cpuCapacity();
+
+private:
+    /// Accumulated cpu times from /proc/stat in clock ticks.
+    struct CpuTimes {
+        uint64_t total = 0;
+        uint64_t idle = 0;
+        uint64_t iowait = 0;
+    };
+
+    static bool readCpuTimes(CpuTimes &times);
+
+    /// Cpus granted by the cgroup cpu quota, 0 if unlimited.
+    static double cgroupQuota();
+
+    size_t min_;
+    size_t max_;
+    double capacity_;
+
+    std::atomic<uint64_t> items_;
+    std::atomic<uint64_t> latencyUs_;
+
+    std::mutex lock_;
+    std::chrono::steady_clock::time_point last_;
+    CpuTimes lastTimes_;
+    /// Throughput and latency before the last step up, 0 if the last
+    /// step was not up.
+    double grownFromRate_;
+    double grownFromLatency_;
+};
@@ -0,0 +1,131 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "UnitTest.h"
+#include "cachefile.h"
+
+#include <fstream>
+#include <string>
+
+namespace {
+
+/// Write a cache file with two items and their directory.
+bool writeCacheFile(const std::string &path)
+{
+    // records are added out of order, the writer sorts them
+    CacheFile::Writer writer;
+    writer.addItem("/music/b.mp3", 2, MediaItem::Type::Audio, "b.jpg", 200, 20, false);
+    writer.addItem("/music/a.mp3", 1, MediaItem::Type::Audio, "", 100, 10, true);
+    writer.addDir("/music", 3, 2);
+    return writer.write(path, true);
+}
+
+/// Flip one bit of the file at offset from its end.
+void damage(const std::string &path, std::streamoff offset)
+{
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(-offset, std::ios::end);
+    char c = 0;
+    file.get(c);
+    file.seekp(-offset, std::ios::end);
+    file.put(static_cast<char>(c ^ 0x1));
+}
+
+void testCacheFileRoundTrip()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin";
+    EXPECT(writeCacheFile(path));
+
+    CacheFile file;
+    EXPECT(file.open(path));
+    EXPECT(file.complete());
+    EXPECT(file.verified(0) && file.verified(1));
+    EXPECT(file.itemCount() == 2);
+    EXPECT(file.dirCount() == 1);
+    if (file.itemCount() == 2) {
+        auto item = file.item(0);
+        EXPECT(item.path == "/music/a.mp3");
+        EXPECT(item.hash == 1);
+        EXPECT(item.size == 100);
+        EXPECT(item.inode == 10);
+        EXPECT(item.type == MediaItem::Type::Audio);
+        EXPECT(item.thumbnail.empty());
+        EXPECT(item.pending);
+    }
+
+    auto found = file.findItem("/music/b.mp3");
+    EXPECT(found.has_value());
+    if (found) {
+        EXPECT(found->hash == 2);
+        EXPECT(found->thumbnail == "b.jpg");
+        EXPECT(!found->pending);
+    }
+    EXPECT(!file.findItem("/music/c.mp3"));
+
+    auto dir = file.findDir("/music");
+    EXPECT(dir.has_value());
+    if (dir) {
+        EXPECT(dir->hash == 3);
+        EXPECT(dir->count == 2);
+    }
+    EXPECT(!file.findDir("/video"));
+    file.close();
+    EXPECT(!file.isOpen());
+}
+
+void testCacheFileChecksum()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin";
+
+    // a damaged string table is detected
+    EXPECT(writeCacheFile(path));
+    damage(path, 1);
+    CacheFile file;
+    EXPECT(!file.open(path));
+    EXPECT(!file.isOpen());
+
+    // so is a truncated file
+    EXPECT(writeCacheFile(path));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    EXPECT(!file.open(path));
+
+    // and a missing one
+    EXPECT(!file.open(tmp.path() + "/missing.bin"));
+
+    // damaged items are only found once their block is used, the
+    // directory strings "/music" are the last ones in the file
+    EXPECT(writeCacheFile(path));
+    damage(path, 7);
+    EXPECT(file.open(path));
+    EXPECT(!file.verified(0));
+    EXPECT(!file.findItem("/music/a.mp3"));
+    EXPECT(file.findDir("/music").has_value());
+
+    // a good file after all
+    EXPECT(writeCacheFile(path));
+    EXPECT(file.open(path));
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(testCacheFileRoundTrip);
+    RUN_TEST(testCacheFileChecksum);
+    return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "UnitTest.h"
+#include "cache.h"
+#include "cachejournal.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Read all records of a journal file.
+std::vector<CacheJournal::Record> replay(const std::string &path)
+{
+    std::vector<CacheJournal::Record> records;
+    CacheJournal journal(path);
+    journal.replay([&records] (CacheJournal::Record &&rec) {
+        records.push_back(std::move(rec));
+    });
+    return records;
+}
+
+/// Write a journal with two items and a removal.
+bool writeJournal(const std::string &path)
+{
+    CacheJournal journal(path);
+    journal.appendItem("/music/a.mp3", 1, MediaItem::Type::Audio, "a.jpg", 100, 10);
+    journal.appendItem("/music/b.mp3", 2, MediaItem::Type::Audio, "", 200, 20);
+    journal.appendRemove("/music/old");
+    return journal.flush();
+}
+
+void testReplay()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin.journal";
+    EXPECT(writeJournal(path));
+
+    auto records = replay(path);
+    EXPECT(records.size() == 3);
+    if (records.size() == 3) {
+        EXPECT(records[0].type == CacheJournal::Record::Type::Item);
+        EXPECT(records[0].path == "/music/a.mp3");
+        EXPECT(records[0].thumbnail == "a.jpg");
+        EXPECT(records[0].hash == 1);
+        EXPECT(records[0].size == 100);
+        EXPECT(records[0].inode == 10);
+        EXPECT(records[0].mediaType == MediaItem::Type::Audio);
+        EXPECT(records[2].type == CacheJournal::Record::Type::Remove);
+        EXPECT(records[2].path == "/music/old");
+    }
+
+    // a file which is no journal is ignored
+    std::ofstream(path, std::ios::trunc) << "no journal";
+    EXPECT(replay(path).empty());
+}
+
+void testTornRecord()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin.journal";
+    EXPECT(writeJournal(path));
+
+    // the removal record has been written halfway only
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+    EXPECT(replay(path).size() == 2);
+
+    // new records go behind the last intact one
+    {
+        CacheJournal journal(path);
+        EXPECT(journal.replay([] (CacheJournal::Record &&) {}) == 2);
+        journal.appendRemove("/music/a.mp3");
+        EXPECT(journal.flush());
+    }
+    auto records = replay(path);
+    EXPECT(records.size() == 3);
+    if (records.size() == 3)
+        EXPECT(records[2].path == "/music/a.mp3");
+
+    // a damaged record ends the replay as well
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-1, std::ios::end);
+        file.put('x');
+    }
+    EXPECT(replay(path).size() == 2);
+}
+
+void testRecovery()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin";
+
+    // the scan is interrupted before the cache file is written, its
+    // checkpoint only went to the journal
+    {
+        Cache cache(path);
+        cache.insertItem("/music/a.mp3", 1, MediaItem::Type::Audio, "", 100, 10);
+        cache.insertItem("/music/b.mp3", 2, MediaItem::Type::Audio, "", 200, 20);
+        cache.removeItems("/music/b.mp3");
+        EXPECT(cache.saveCheckpoint());
+    }
+    EXPECT(!std::filesystem::exists(path));
+    EXPECT(std::filesystem::exists(path + CACHE_JOURNAL_SUFFIX));
+
+    // journaled items may not be in the database, the resumed walk
+    // checks them again but knows them
+    Cache cache(path);
+    EXPECT(cache.readCache());
+    EXPECT(cache.isResumable());
+    EXPECT(cache.isRenameCandidate(1, 100));
+    EXPECT(!cache.isRenameCandidate(2, 200));
+    EXPECT(!cache.isExist("/music/a.mp3", 1));
+}
+
+void testCompaction()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin";
+    const std::string dir = "/music/" + std::string(200, 'x');
+
+    // enough records to exceed the compaction size
+    {
+        Cache cache(path);
+        cache.insertDirectory(dir, 1);
+        for (unsigned long idx = 0; idx < 8000; ++idx)
+            cache.insertItem(dir + "/" + std::to_string(idx) + ".mp3", idx + 1,
+                MediaItem::Type::Audio, "", 100, idx);
+        EXPECT(cache.saveCheckpoint());
+    }
+    // the records went to a new cache file, the journal is gone
+    EXPECT(std::filesystem::exists(path));
+    EXPECT(!std::filesystem::exists(path + CACHE_JOURNAL_SUFFIX));
+    // the items have been stored in the database
+    std::ofstream(path + CACHE_COMMIT_SUFFIX);
+
+    Cache cache(path);
+    EXPECT(cache.readCache());
+    EXPECT(cache.isExist(dir + "/0.mp3", 1));
+    EXPECT(cache.isExist(dir + "/7999.mp3", 8000));
+    EXPECT(!cache.isExist(dir + "/8000.mp3", 8001));
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(testReplay);
+    RUN_TEST(testTornRecord);
+    RUN_TEST(testRecovery);
+    RUN_TEST(testCompaction);
+    return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "UnitTest.h"
+#include "cache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void testCarryOverSiblings()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin";
+
+    // "Album (Disc 2)" sorts between "Album" and "Album/CD1"
+    const std::vector<std::pair<std::string, unsigned long>> dirs = {
+        { "/music", 1 },
+        { "/music/Album", 2 },
+        { "/music/Album (Disc 2)", 3 },
+        { "/music/Album/CD1", 4 },
+    };
+    {
+        Cache cache(path);
+        for (const auto &dir : dirs)
+            cache.insertDirectory(dir.first, dir.second);
+        cache.insertItem("/music/intro.mp3", 11, MediaItem::Type::Audio, "", 100, 1);
+        cache.insertItem("/music/Album/a.mp3", 12, MediaItem::Type::Audio, "", 100, 2);
+        cache.insertItem("/music/Album (Disc 2)/b.mp3", 13, MediaItem::Type::Audio, "", 100, 3);
+        cache.insertItem("/music/Album/CD1/c.mp3", 14, MediaItem::Type::Audio, "", 100, 4);
+        for (const auto &dir : dirs)
+            cache.completeDirectory(dir.first);
+        EXPECT(cache.generateCacheFile());
+    }
+    // the items have been stored in the database
+    std::ofstream(path + CACHE_COMMIT_SUFFIX);
+
+    Cache cache(path);
+    EXPECT(cache.readCache());
+
+    std::vector<std::string> subdirs;
+    std::vector<MediaItem::Type> types;
+    EXPECT(cache.carryOverDirectory("/music", 1, subdirs, types));
+    std::sort(subdirs.begin(), subdirs.end());
+    EXPECT(subdirs == std::vector<std::string>({ "/music/Album", "/music/Album (Disc 2)" }));
+    EXPECT(types.size() == 1);
+
+    // the walker goes on with the subdirectories
+    subdirs.clear();
+    types.clear();
+    EXPECT(cache.carryOverDirectory("/music/Album", 2, subdirs, types));
+    EXPECT(subdirs == std::vector<std::string>({ "/music/Album/CD1" }));
+    EXPECT(types.size() == 1);
+
+    subdirs.clear();
+    types.clear();
+    EXPECT(cache.carryOverDirectory("/music/Album (Disc 2)", 3, subdirs, types));
+    EXPECT(subdirs.empty());
+    EXPECT(types.size() == 1);
+
+    // a modified directory has to be read again
+    subdirs.clear();
+    types.clear();
+    EXPECT(!cache.carryOverDirectory("/music/Album/CD1", 5, subdirs, types));
+    EXPECT(subdirs.empty());
+    EXPECT(types.empty());
+}
+
+void testRenameCandidate()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/cache.bin";
+    {
+        Cache cache(path);
+        cache.insertDirectory("/music", 1);
+        cache.insertItem("/music/a.mp3", 1, MediaItem::Type::Audio, "", 100, 10);
+        cache.insertItem("/music/b.mp3", 2, MediaItem::Type::Audio, "", 200, 20);
+        // items without size are never taken as moved
+        cache.insertItem("/music/c.mp3", 3, MediaItem::Type::Audio, "", 0, 30);
+        cache.completeDirectory("/music");
+        EXPECT(cache.generateCacheFile());
+    }
+
+    // the keys are there right after reading, before any lookup had
+    // to wait for the loader
+    Cache cache(path);
+    EXPECT(cache.readCache());
+    EXPECT(cache.isRenameCandidate(1, 100));
+    EXPECT(cache.isRenameCandidate(2, 200));
+    EXPECT(!cache.isRenameCandidate(1, 200));
+    EXPECT(!cache.isRenameCandidate(3, 100));
+    EXPECT(!cache.isRenameCandidate(3, 0));
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(testCarryOverSiblings);
+    RUN_TEST(testRenameCandidate);
+    return UNIT_TEST_RESULT();
+}
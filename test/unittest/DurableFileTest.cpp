@@ -0,0 +1,127 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "UnitTest.h"
+#include "durablefile.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace {
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void testReplace()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/file";
+    std::ofstream(path) << "old";
+
+    // the old content stays until the new one is committed
+    {
+        DurableFile file(path);
+        EXPECT(file.write("new ", 4));
+        EXPECT(file.write("content", 7));
+        EXPECT(readFile(path) == "old");
+        EXPECT(file.commit());
+    }
+    EXPECT(readFile(path) == "new content");
+    EXPECT(!std::filesystem::exists(path + ".tmp"));
+
+    // an empty file can be written as well
+    {
+        DurableFile file(path);
+        EXPECT(file.commit());
+    }
+    EXPECT(std::filesystem::exists(path));
+    EXPECT(readFile(path).empty());
+}
+
+void testAbandon()
+{
+    TempDir tmp;
+    std::string path = tmp.path() + "/file";
+    std::ofstream(path) << "old";
+
+    // nothing changes without a commit
+    {
+        DurableFile file(path);
+        EXPECT(file.write("new", 3));
+    }
+    EXPECT(readFile(path) == "old");
+    EXPECT(!std::filesystem::exists(path + ".tmp"));
+
+    // a missing directory fails cleanly
+    DurableFile missing(tmp.path() + "/missing/file");
+    EXPECT(!missing.write("new", 3));
+    EXPECT(!missing.commit());
+}
+
+void testDirectory()
+{
+    EXPECT(DurableFile::directory("/a/b/file") == "/a/b/");
+    EXPECT(DurableFile::directory("file").empty());
+
+    TempDir tmp;
+    EXPECT(DurableFile::syncDirectory(tmp.path()));
+    EXPECT(!DurableFile::syncDirectory(tmp.path() + "/missing"));
+}
+
+void testUnlinkBatch()
+{
+    TempDir tmp;
+    std::filesystem::create_directory(tmp.path() + "/sub");
+    std::ofstream(tmp.path() + "/a");
+    std::ofstream(tmp.path() + "/sub/b");
+
+    UnlinkBatch batch;
+    batch.add(tmp.path() + "/a");
+    batch.add(tmp.path() + "/sub/b");
+    // files which are gone already do not count as failed
+    batch.add(tmp.path() + "/missing");
+    EXPECT(std::filesystem::exists(tmp.path() + "/a"));
+    EXPECT(batch.commit() == 0);
+    EXPECT(!std::filesystem::exists(tmp.path() + "/a"));
+    EXPECT(!std::filesystem::exists(tmp.path() + "/sub/b"));
+
+    // a directory can not be unlinked
+    batch.add(tmp.path() + "/sub");
+    EXPECT(batch.commit() == 1);
+
+    // the destructor removes what has not been committed
+    std::ofstream(tmp.path() + "/c");
+    {
+        UnlinkBatch pending;
+        pending.add(tmp.path() + "/c");
+    }
+    EXPECT(!std::filesystem::exists(tmp.path() + "/c"));
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(testReplace);
+    RUN_TEST(testAbandon);
+    RUN_TEST(testDirectory);
+    RUN_TEST(testUnlinkBatch);
+    return UNIT_TEST_RESULT();
+}
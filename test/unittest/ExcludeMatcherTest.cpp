@@ -0,0 +1,106 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "UnitTest.h"
+#include "excludematcher.h"
+
+namespace {
+
+const std::string root = "/media/usb";
+
+ExcludeConfig config()
+{
+    ExcludeConfig config;
+    config.hidden = true;
+    config.nomedia = true;
+    config.maxDepth = 3;
+    config.directories = { "Trash", "thumbnails" };
+    config.patterns = { "/Android/data/", "Backup*/old", "/" };
+    return config;
+}
+
+void testRoot()
+{
+    ExcludeMatcher matcher(config());
+    // the mountpoint itself and everything outside are never excluded
+    EXPECT(!matcher.excludeDirectory(root, root));
+    EXPECT(!matcher.excludeDirectory(root, root + "/"));
+    EXPECT(!matcher.excludeDirectory(root, "/media/other/Trash"));
+    // neither is a sibling mountpoint sharing the name prefix
+    EXPECT(!matcher.excludeDirectory(root, "/media/usb2/Trash"));
+    EXPECT(!matcher.excludeDirectory(root, "/media/usb.git"));
+    // a trailing slash of the mountpoint does not matter
+    EXPECT(matcher.excludeDirectory(root + "/", root + "/Trash"));
+}
+
+void testNames()
+{
+    ExcludeMatcher matcher(config());
+    EXPECT(matcher.excludeDirectory(root, root + "/Trash"));
+    EXPECT(matcher.excludeDirectory(root, root + "/music/TRASH"));
+    EXPECT(matcher.excludeDirectory(root, root + "/photo/Thumbnails"));
+    EXPECT(!matcher.excludeDirectory(root, root + "/Trash2"));
+    EXPECT(!matcher.excludeDirectory(root, root + "/music"));
+}
+
+void testPatterns()
+{
+    ExcludeMatcher matcher(config());
+    // literal paths are relative to the mountpoint, case insensitive
+    EXPECT(matcher.excludeDirectory(root, root + "/Android/data"));
+    EXPECT(matcher.excludeDirectory(root, root + "/android/DATA"));
+    EXPECT(!matcher.excludeDirectory(root, root + "/music/Android/data"));
+    EXPECT(!matcher.excludeDirectory(root, root + "/Android"));
+
+    // wildcards do not match a slash
+    EXPECT(matcher.excludeDirectory(root, root + "/Backup2020/old"));
+    EXPECT(matcher.excludeDirectory(root, root + "/backup/OLD"));
+    EXPECT(!matcher.excludeDirectory(root, root + "/Backup2020/new"));
+    EXPECT(!matcher.excludeDirectory(root, root + "/Backup/2020/old"));
+}
+
+void testHiddenAndDepth()
+{
+    ExcludeMatcher matcher(config());
+    EXPECT(matcher.excludeDirectory(root, root + "/music/.git"));
+    EXPECT(matcher.excludeFile(root + "/music/.cover.jpg"));
+    EXPECT(!matcher.excludeFile(root + "/music/cover.jpg"));
+    EXPECT(!matcher.excludeFile("song.mp3"));
+    EXPECT(matcher.excludeFile(".song.mp3"));
+
+    EXPECT(!matcher.excludeDirectory(root, root + "/a/b/c"));
+    EXPECT(matcher.excludeDirectory(root, root + "/a/b/c/d"));
+    EXPECT(matcher.skipMarker() == ".nomedia");
+
+    ExcludeConfig plain;
+    plain.hidden = false;
+    ExcludeMatcher all(plain);
+    EXPECT(!all.excludeDirectory(root, root + "/music/.git"));
+    EXPECT(!all.excludeFile(root + "/music/.cover.jpg"));
+    EXPECT(!all.excludeDirectory(root, root + "/a/b/c/d/e/f"));
+    EXPECT(all.skipMarker().empty());
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(testRoot);
+    RUN_TEST(testNames);
+    RUN_TEST(testPatterns);
+    RUN_TEST(testHiddenAndDepth);
+    return UNIT_TEST_RESULT();
+}
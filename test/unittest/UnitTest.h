@@ -0,0 +1,73 @@
+// Copyright (c) 2024 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+/// Number of failed checks of the test program.
+static int unitTestFailures = 0;
+
+/// Report a failed check, the test goes on with the next one.
+#define EXPECT(cond)                                                    \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__                    \
+                      << ": check failed: " << #cond << std::endl;      \
+            unitTestFailures++;                                         \
+        }                                                               \
+    } while (0)
+
+/// Run a test function and report its name.
+#define RUN_TEST(test)                                                  \
+    do {                                                                \
+        std::cout << "running " << #test << std::endl;                  \
+        test();                                                         \
+    } while (0)
+
+/// Exit code for ctest.
+#define UNIT_TEST_RESULT() (unitTestFailures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+/// Temporary directory, removed with everything in it when going out
+/// of scope.
+class TempDir
+{
+public:
+    TempDir()
+    {
+        std::string tmpl = (std::filesystem::temp_directory_path() / "mediaindexer-XXXXXX").string();
+        if (mkdtemp(tmpl.data()))
+            path_ = tmpl;
+    }
+
+    ~TempDir()
+    {
+        std::error_code ec;
+        if (!path_.empty())
+            std::filesystem::remove_all(path_, ec);
+    }
+
+    TempDir(const TempDir &) = delete;
+    TempDir &operator=(const TempDir &) = delete;
+
+    const std::string &path() const { return path_; }
+
+private:
+    std::string path_;
+};